@@ -0,0 +1,280 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+/** The MRChem kernel benchmarks
+ *
+ * Runs the core computational kernels on a synthetic orbital set, hydrogen 1s
+ * orbitals on a linear chain or a cubic cluster of atoms, and reports the wall
+ * time (min/avg/max over the repetitions), the throughput and the memory of
+ * each kernel in JSON. No external data is needed, so the benchmarks can be
+ * run offline to compare the performance of different builds or versions.
+ */
+
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <random>
+
+#include <MRCPP/MWOperators>
+#include <MRCPP/Printer>
+#include <MRCPP/Timer>
+
+#include "mrchem.h"
+#include "mrenv.h"
+#include "parallel.h"
+#include "version.h"
+
+#include "analyticfunctions/HydrogenFunction.h"
+#include "chemistry/Nucleus.h"
+#include "mrdft/Factory.h"
+#include "mrdft/MRDFT.h"
+#include "qmfunctions/Density.h"
+#include "qmfunctions/Orbital.h"
+#include "qmfunctions/density_utils.h"
+#include "qmfunctions/orbital_utils.h"
+#include "qmfunctions/qmfunction_utils.h"
+#include "qmoperators/one_electron/NuclearOperator.h"
+#include "qmoperators/two_electron/ExchangeOperator.h"
+#include "scf_solver/HelmholtzVector.h"
+#include "utils/math_utils.h"
+#include "utils/memory_utils.h"
+#include "utils/print_utils.h"
+
+// Initializing global variables
+mrcpp::MultiResolutionAnalysis<3> *mrchem::MRA;
+
+using json = nlohmann::json;
+using Timer = mrcpp::Timer;
+using namespace mrchem;
+
+namespace {
+
+Nuclei setup_system(const json &json_bench) {
+    auto system = json_bench["system"].get<std::string>();
+    auto n_atoms = json_bench["n_atoms"].get<int>();
+    auto spacing = json_bench["spacing"].get<double>();
+
+    Nuclei nucs;
+    if (system == "chain") {
+        double x_0 = -0.5 * spacing * (n_atoms - 1);
+        for (int i = 0; i < n_atoms; i++) nucs.push_back("H", {x_0 + i * spacing, 0.0, 0.0});
+    } else if (system == "cluster") {
+        auto n_side = static_cast<int>(std::ceil(std::cbrt(static_cast<double>(n_atoms))));
+        double x_0 = -0.5 * spacing * (n_side - 1);
+        for (int i = 0; i < n_atoms; i++) {
+            double x = x_0 + (i % n_side) * spacing;
+            double y = x_0 + ((i / n_side) % n_side) * spacing;
+            double z = x_0 + (i / (n_side * n_side)) * spacing;
+            nucs.push_back("H", {x, y, z});
+        }
+    } else {
+        MSG_ABORT("Invalid benchmark system: " << system);
+    }
+    return nucs;
+}
+
+OrbitalVector setup_orbitals(double prec, const Nuclei &nucs) {
+    OrbitalVector Phi;
+    for (int i = 0; i < nucs.size(); i++) Phi.push_back(Orbital(SPIN::Paired));
+    mpi::distribute(Phi);
+
+    for (int i = 0; i < nucs.size(); i++) {
+        HydrogenFunction f(1, 0, 0, 1.0, nucs[i].getCoord());
+        if (mpi::my_orb(Phi[i])) qmfunction::project(Phi[i], f, NUMBER::Real, prec);
+    }
+    return Phi;
+}
+
+/** @brief Run a kernel repeatedly and collect its statistics
+ *
+ * @param repeat: number of repetitions
+ * @param unit: unit of the work items returned by the kernel
+ * @param kernel: runs the kernel once and returns the number of work items
+ *
+ * The kernel calls the given done() once its output is complete, before the
+ * output goes out of scope. This stops the timer and measures the memory
+ * increase on each rank while the output is still alive, which is reported
+ * as the max across ranks.
+ */
+json run_kernel(int repeat, const std::string &unit, const std::function<double(const std::function<void()> &)> &kernel) {
+    DoubleVector times = DoubleVector::Zero(repeat);
+    double items = 0.0;
+    double mem_inc = 0.0;
+    for (int n = 0; n < repeat; n++) {
+        mpi::barrier(mpi::comm_orb);
+        double mem_0 = memory_utils::get_usage();
+        Timer timer;
+        auto done = [&]() {
+            mpi::barrier(mpi::comm_orb);
+            timer.stop();
+            mem_inc = std::max(mem_inc, memory_utils::get_usage() - mem_0);
+        };
+        items = kernel(done);
+        times(n) = timer.elapsed();
+    }
+    DoubleVector mem_vec = DoubleVector::Zero(mpi::orb_size);
+    mem_vec(mpi::orb_rank) = mem_inc;
+    mpi::allreduce_vector(mem_vec, mpi::comm_orb);
+
+    json out;
+    out["repeat"] = repeat;
+    out["wall_time"] = {{"min", times.minCoeff()}, {"avg", times.mean()}, {"max", times.maxCoeff()}};
+    out["throughput"] = {{"value", items / times.minCoeff()}, {"unit", unit + "/s"}};
+    out["memory_increase"] = mem_vec.maxCoeff();
+    out["peak_memory"] = memory_utils::get_peak();
+    return out;
+}
+
+json run_benchmarks(const json &json_bench) {
+    auto prec = json_bench["prec"].get<double>();
+    auto repeat = json_bench["repeat"].get<int>();
+    auto kernels = json_bench["kernels"].get<std::vector<std::string>>();
+
+    Timer t_setup;
+    Nuclei nucs = setup_system(json_bench);
+    OrbitalVector Phi = setup_orbitals(prec, nucs);
+    int N = Phi.size();
+
+    json out;
+    out["system"] = {{"system", json_bench["system"]},
+                     {"n_atoms", N},
+                     {"spacing", json_bench["spacing"]},
+                     {"prec", prec},
+                     {"basis_order", MRA->getOrder()},
+                     {"orbital_nodes", orbital::get_n_nodes(Phi)},
+                     {"orbital_size", orbital::get_size_nodes(Phi) / 1024.0},
+                     {"setup_time", t_setup.elapsed()}};
+
+    for (const auto &kernel : kernels) {
+        mrcpp::print::header(0, "Benchmark: " + kernel);
+        json json_kernel;
+        if (kernel == "rotate") {
+            // Deterministic random unitary matrix
+            std::mt19937 gen(1234);
+            std::uniform_real_distribution<double> dist(-0.5, 0.5);
+            DoubleMatrix A = DoubleMatrix::Zero(N, N);
+            for (int i = 0; i < N; i++) {
+                for (int j = 0; j < i; j++) {
+                    A(i, j) = dist(gen);
+                    A(j, i) = -A(i, j);
+                }
+            }
+            ComplexMatrix U = math_utils::skew_matrix_exp(A).cast<ComplexDouble>();
+            json_kernel = run_kernel(repeat, "orbitals", [&](const std::function<void()> &done) {
+                OrbitalVector Psi = orbital::rotate(Phi, U, prec);
+                done();
+                return static_cast<double>(N);
+            });
+        } else if (kernel == "overlap") {
+            json_kernel = run_kernel(repeat, "elements", [&](const std::function<void()> &done) {
+                ComplexMatrix S = orbital::calc_overlap_matrix(Phi);
+                done();
+                return static_cast<double>(N * N);
+            });
+        } else if (kernel == "exchange") {
+            // Full precomputation of K|phi_i>, all pairs across the ranks through the bank
+            auto P_p = std::make_shared<mrcpp::PoissonOperator>(*MRA, prec);
+            auto Phi_p = std::make_shared<OrbitalVector>(Phi);
+            ExchangeOperator K(P_p, Phi_p, prec);
+            K.setPreCompute();
+            json_kernel = run_kernel(repeat, "pairs", [&](const std::function<void()> &done) {
+                K.setup(prec);
+                done();
+                K.clear();
+                return 0.5 * N * (N + 1);
+            });
+        } else if (kernel == "xc") {
+            mrdft::Factory xc_factory(*MRA);
+            xc_factory.setOrder(1);
+            xc_factory.setFunctional(json_bench["functional"].get<std::string>(), 1.0);
+            xc_factory.setDensityCutoff(1.0e-10);
+            auto mrdft_p = xc_factory.build();
+
+            Density rho(false);
+            density::compute(prec, rho, Phi, DensityType::Total);
+            json_kernel = run_kernel(repeat, "nodes", [&](const std::function<void()> &done) {
+                mrcpp::FunctionTreeVector<3> xc_inp;
+                xc_inp.push_back(std::make_tuple(1.0, &rho.real()));
+                mrcpp::FunctionTreeVector<3> xc_out = mrdft_p->evaluate(xc_inp);
+                done();
+                double n_nodes = mrdft_p->grid().size();
+                mrcpp::clear(xc_out, true);
+                return n_nodes;
+            });
+        } else if (kernel == "helmholtz") {
+            NuclearOperator V(nucs, prec, prec);
+            V.setup(prec);
+            HelmholtzVector H(prec, DoubleVector::Constant(N, -0.5));
+            json_kernel = run_kernel(repeat, "orbitals", [&](const std::function<void()> &done) {
+                OrbitalVector Psi = H.apply(V, Phi, Phi);
+                done();
+                return static_cast<double>(N);
+            });
+            V.clear();
+        } else if (kernel == "density") {
+            json_kernel = run_kernel(repeat, "orbitals", [&](const std::function<void()> &done) {
+                Density rho(false);
+                density::compute(prec, rho, Phi, DensityType::Total);
+                done();
+                return static_cast<double>(N);
+            });
+        } else {
+            MSG_ABORT("Invalid benchmark kernel: " << kernel);
+        }
+        print_utils::scalar(0, "Min wall time", json_kernel["wall_time"]["min"].get<double>(), "(sec)", 5, true);
+        print_utils::scalar(0, "Max memory increase", json_kernel["memory_increase"].get<double>(), "(MB)", 2, false);
+        mrcpp::print::separator(0, '=', 2);
+        out["kernels"][kernel] = json_kernel;
+    }
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto json_inp = mrenv::fetch_json(argc, argv);
+    mrenv::initialize(json_inp);
+    const auto &json_bench = json_inp["benchmark"];
+
+    Timer timer;
+    json json_out;
+    json_out["provenance"] = {{"creator", "MRChem"},
+                              {"version", program_version()},
+                              {"nthreads", omp::n_threads},
+                              {"mpi_processes", mpi::world_size},
+                              {"routine", "mrchem-bench.x"}};
+    json_out["benchmark"] = run_benchmarks(json_bench);
+    timer.stop();
+    mrenv::finalize(timer.elapsed());
+
+    if (mpi::grand_master()) {
+        std::ofstream ofs(json_bench["output"].get<std::string>(), std::ios::out);
+        ofs << std::setw(2) << json_out << std::endl;
+        ofs.close();
+    }
+
+    mpi::finalize();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,317 @@
+#!/usr/bin/env python3
+#
+# MRChem, a numerical real-space code for molecular electronic structure
+# calculations within the self-consistent field (SCF) approximations of quantum
+# chemistry (Hartree-Fock and Density Functional Theory).
+# Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+#
+# This file is part of MRChem.
+#
+# MRChem is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# MRChem is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+#
+# For information on the complete list of contributors to MRChem, see:
+# <https://mrchem.readthedocs.io/>
+#
+
+"""Strong and weak scaling harness for MRChem.
+
+Generates inputs for synthetic systems of growing size (water clusters or
+alkane chains), runs complete SCF (and optionally response) calculations over
+a matrix of MPI ranks, OpenMP threads and bank sizes, and collects the timings
+from the output JSON into a report with parallel efficiencies. The run fails
+if any efficiency drops below the stored baseline by more than the tolerance,
+and it refuses to start if no baseline is stored for the requested mode,
+system and method (unless --update-baseline is given).
+
+Example, strong scaling of a 4-molecule water cluster:
+
+    ./scaling.py --mrchem=/path/to/bin/mrchem --system=water --size=4 \\
+                 --ranks=1,2,4 --threads=1,2 --banks=0,1 --mode=strong
+
+Efficiencies are computed relative to the configuration with the fewest
+cores: T_ref * n_ref / (T * n) for strong scaling, where the system size is
+fixed, and T_ref / T for weak scaling, where the system size is increased in
+proportion to the number of worker cores.
+"""
+
+import argparse
+import json
+import math
+import os
+import subprocess
+import sys
+from pathlib import Path
+
+
+def water_cluster(n_mol):
+    """Water molecules on a cubic lattice with 3.0 Angstrom spacing"""
+    n_side = math.ceil(round(n_mol ** (1.0 / 3.0), 6))
+    spacing = 3.0
+    coords = []
+    for i in range(n_mol):
+        x = spacing * (i % n_side)
+        y = spacing * ((i // n_side) % n_side)
+        z = spacing * (i // (n_side * n_side))
+        coords.append(("O", x, y, z))
+        coords.append(("H", x + 0.757, y + 0.586, z))
+        coords.append(("H", x - 0.757, y + 0.586, z))
+    return coords
+
+
+def alkane_chain(n_carbon):
+    """All-trans CnH2n+2 chain along the x axis"""
+    dx, dy = 1.2575, 0.4446  # C-C bond of 1.54 Angstrom with tetrahedral angle
+    coords = []
+    for i in range(n_carbon):
+        side = 1.0 if i % 2 == 0 else -1.0
+        x, y = i * dx, side * dy
+        coords.append(("C", x, y, 0.0))
+        coords.append(("H", x, y + side * 0.63, 0.89))
+        coords.append(("H", x, y + side * 0.63, -0.89))
+    coords.append(("H", -1.03, dy + 0.36, 0.0))
+    side = 1.0 if (n_carbon - 1) % 2 == 0 else -1.0
+    coords.append(("H", (n_carbon - 1) * dx + 1.03, side * (dy + 0.36), 0.0))
+    return coords
+
+
+SYSTEMS = {"water": water_cluster, "alkane": alkane_chain}
+
+
+def write_input(path, coords, bank, args):
+    """Write a getkw input file for the given geometry and bank size"""
+    lines = [
+        f"world_prec = {args.prec}",
+        "world_unit = angstrom",
+        "",
+        "MPI {",
+        f"  bank_size = {bank}",
+        "}",
+        "",
+        "Molecule {",
+        "$coords",
+    ]
+    lines += [f"{a:2s} {x:12.6f} {y:12.6f} {z:12.6f}" for a, x, y, z in coords]
+    lines += ["$end", "}", "", "WaveFunction {", f"  method = {args.method}", "}", ""]
+    if args.response:
+        lines += ["Properties {", "  polarizability = true", "}", ""]
+    lines += ["SCF {", f"  max_iter = {args.max_iter}", "}", ""]
+    path.write_text("\n".join(lines))
+
+
+def configurations(args):
+    """All valid (ranks, threads, bank) combinations, fewest cores first"""
+    configs = []
+    for ranks in args.ranks:
+        for threads in args.threads:
+            for bank in args.banks:
+                if ranks == 1 and bank > 0:
+                    continue
+                if ranks > 1 and (bank < 1 or bank >= ranks):
+                    continue
+                configs.append((ranks, threads, bank))
+    return sorted(configs, key=lambda c: ((c[0] - c[2]) * c[1], c))
+
+
+def label(config):
+    ranks, threads, bank = config
+    return f"r{ranks}t{threads}b{bank}"
+
+
+def worker_cores(config):
+    ranks, threads, bank = config
+    return (ranks - bank) * threads
+
+
+def collect_timings(out_json):
+    """Total and per-section wall times (max across ranks) from the output"""
+    with out_json.open("r") as fd:
+        out = json.load(fd)["output"]
+    sections = {
+        name: sec["wall_time"]["max"] for name, sec in out.get("timings", {}).items()
+    }
+    memory = out.get("memory", {}).get("process", {}).get("max", None)
+    return {
+        "success": out.get("success", False),
+        "wall_time": sum(sections.values()),
+        "sections": sections,
+        "memory": memory,
+    }
+
+
+def run_config(config, size, args):
+    ranks, threads, bank = config
+    run_dir = Path(args.work_dir) / f"{args.system}_{size}" / label(config)
+    run_dir.mkdir(parents=True, exist_ok=True)
+    name = f"{args.system}_{size}"
+    write_input(run_dir / f"{name}.inp", SYSTEMS[args.system](size), bank, args)
+
+    launcher = args.launcher.format(ranks=ranks)
+    command = [args.mrchem, name, f"--launcher={launcher}"]
+    if args.executable is not None:
+        command.append(f"--executable={args.executable}")
+    sys.stdout.write(f"{label(config)}: OMP_NUM_THREADS={threads} {' '.join(command)}\n")
+    if args.dry_run:
+        return None
+
+    env = dict(os.environ, OMP_NUM_THREADS=str(threads))
+    child = subprocess.run(command, cwd=run_dir, env=env, universal_newlines=True)
+    if child.returncode != 0:
+        sys.stdout.write(f"{label(config)}: run failed with exit code {child.returncode}\n")
+        return None
+    return collect_timings(run_dir / f"{name}.json")
+
+
+def compute_efficiencies(results, mode):
+    """Parallel efficiency of each configuration relative to the first one"""
+    ref = next((r for r in results if r["timing"] is not None), None)
+    if ref is None:
+        return
+    t_ref, n_ref = ref["timing"]["wall_time"], ref["cores"]
+    for res in results:
+        if res["timing"] is None or res["timing"]["wall_time"] <= 0.0:
+            res["efficiency"] = None
+            continue
+        t = res["timing"]["wall_time"]
+        if mode == "strong":
+            res["speedup"] = t_ref / t
+            res["efficiency"] = t_ref * n_ref / (t * res["cores"])
+        else:
+            res["speedup"] = t_ref * res["cores"] / (t * n_ref)
+            res["efficiency"] = t_ref / t
+
+
+def check_baseline(results, baseline, tolerance):
+    """Compare with stored efficiencies, returns False on any regression"""
+    passed = True
+    for res in results:
+        ref = baseline.get(res["label"])
+        res["baseline"] = ref
+        if res["timing"] is None or not res["timing"]["success"]:
+            res["status"] = "FAILED"
+            passed = False
+        elif ref is None or res["efficiency"] is None:
+            res["status"] = "NO BASELINE"
+            passed = False
+        elif res["efficiency"] < ref - tolerance:
+            res["status"] = "REGRESSION"
+            passed = False
+        else:
+            res["status"] = "ok"
+    return passed
+
+
+def write_report(path, results, args):
+    """Markdown report with a table and an efficiency curve per configuration"""
+    lines = [
+        f"# MRChem {args.mode} scaling: {args.system}",
+        "",
+        f"method = {args.method}, world_prec = {args.prec}, response = {args.response}",
+        "",
+        "| config | cores | size | wall time (s) | memory (MB) | speedup | efficiency | baseline | status |",
+        "|--------|------:|-----:|--------------:|------------:|--------:|-----------:|---------:|--------|",
+    ]
+
+    def fmt(val, spec):
+        return "-" if val is None else format(val, spec)
+
+    for res in results:
+        timing = res["timing"] or {}
+        lines.append(
+            f"| {res['label']} | {res['cores']} | {res['size']} "
+            f"| {fmt(timing.get('wall_time'), '.2f')} | {fmt(timing.get('memory'), '.1f')} "
+            f"| {fmt(res.get('speedup'), '.2f')} | {fmt(res.get('efficiency'), '.3f')} "
+            f"| {fmt(res.get('baseline'), '.3f')} | {res.get('status', '-')} |"
+        )
+    lines += ["", "Parallel efficiency", "", "```"]
+    for res in results:
+        eff = res.get("efficiency")
+        bar = "" if eff is None else "#" * int(round(50 * min(eff, 1.2)))
+        lines.append(f"{res['label']:>10s} {res['cores']:4d} | {bar} {fmt(eff, '.3f')}")
+    lines += ["```", ""]
+    path.write_text("\n".join(lines))
+
+
+def int_list(txt):
+    return [int(x) for x in txt.split(",")]
+
+
+def cli():
+    parser = argparse.ArgumentParser(description="MRChem scaling harness")
+    parser.add_argument("--mrchem", default="mrchem", help="MRChem launcher script")
+    parser.add_argument("--executable", default=None, help="MRChem executable (mrchem.x)")
+    parser.add_argument("--launcher", default="mpirun -np {ranks}", help="MPI launcher, {ranks} is substituted")
+    parser.add_argument("--system", choices=SYSTEMS.keys(), default="water")
+    parser.add_argument("--size", type=int, default=2, help="Molecules (water) or carbons (alkane) of the reference run")
+    parser.add_argument("--mode", choices=["strong", "weak"], default="strong")
+    parser.add_argument("--ranks", type=int_list, default=[1, 2, 4])
+    parser.add_argument("--threads", type=int_list, default=[1])
+    parser.add_argument("--banks", type=int_list, default=[0, 1])
+    parser.add_argument("--method", default="lda")
+    parser.add_argument("--prec", type=float, default=1.0e-4)
+    parser.add_argument("--max-iter", type=int, default=20)
+    parser.add_argument("--response", action="store_true", help="Include a polarizability calculation")
+    parser.add_argument("--work-dir", default="scaling")
+    parser.add_argument("--report", default="scaling_report.md")
+    parser.add_argument("--baseline", default=str(Path(__file__).resolve().parent / "scaling_baseline.json"))
+    parser.add_argument("--tolerance", type=float, default=0.05, help="Allowed efficiency drop below baseline")
+    parser.add_argument("--update-baseline", action="store_true", help="Store the measured efficiencies as baseline")
+    parser.add_argument("--dry-run", action="store_true", help="Only write the inputs and print the commands")
+    return parser.parse_args()
+
+
+def main():
+    args = cli()
+    configs = configurations(args)
+    if not configs:
+        sys.exit("No valid rank/thread/bank configurations")
+
+    # Refuse to run a check that cannot fail
+    key = f"{args.mode}/{args.system}/{args.method}"
+    baseline_file = Path(args.baseline)
+    baselines = json.loads(baseline_file.read_text()) if baseline_file.exists() else {}
+    if not baselines.get(key) and not (args.update_baseline or args.dry_run):
+        sys.exit(
+            f"No baseline for {key} in {baseline_file}, record one on the reference machine with --update-baseline"
+        )
+    n_ref = worker_cores(configs[0])
+
+    results = []
+    for config in configs:
+        size = args.size
+        if args.mode == "weak":
+            size = max(1, round(args.size * worker_cores(config) / n_ref))
+        timing = run_config(config, size, args)
+        results.append({"label": label(config), "cores": worker_cores(config), "size": size, "timing": timing})
+    if args.dry_run:
+        return 0
+
+    compute_efficiencies(results, args.mode)
+
+    passed = check_baseline(results, baselines.get(key, {}), args.tolerance)
+
+    write_report(Path(args.report), results, args)
+    Path(args.report).with_suffix(".json").write_text(json.dumps({key: results}, indent=2))
+    sys.stdout.write(Path(args.report).read_text())
+
+    if args.update_baseline:
+        baselines[key] = {r["label"]: r["efficiency"] for r in results if r.get("efficiency") is not None}
+        baseline_file.write_text(json.dumps(baselines, indent=2, sort_keys=True) + "\n")
+        sys.stdout.write(f"Baseline {key} written to {baseline_file}\n")
+        return 0
+
+    return 0 if passed else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -64,3 +64,4 @@ set(CMAKE_BUILD_TYPE ${_build_type})
 add_subdirectory(src)
 add_subdirectory(python)
 add_subdirectory(pilot)
+add_subdirectory(bench)
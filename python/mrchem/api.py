@@ -61,6 +61,7 @@ def write_mpi(user_dict):
         "numerically_exact": user_dict["MPI"]["numerically_exact"],
         "shared_memory_size": user_dict["MPI"]["shared_memory_size"],
         "bank_size": user_dict["MPI"]["bank_size"],
+        "memory_budget": user_dict["MPI"]["memory_budget"],
     }
     return mpi_dict
 
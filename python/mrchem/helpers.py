@@ -44,7 +44,8 @@ SHORTHAND_FUNCTIONALS = [
     'olyp',
     'kt1',
     'kt2',
-    'kt3'
+    'kt3',
+    'camb3lyp'
 ]
 # yapf: enable
 """List of recognized shorthands for functionals"""
@@ -84,14 +85,19 @@ def write_scf_fock(user_dict, mol_dict, wf_method, dft_funcs, origin):
     if wf_method in ['hartree', 'hf', 'dft']:
         fock_dict["coulomb_operator"] = {
             "poisson_prec": user_dict["Precisions"]["poisson_prec"],
-            "shared_memory": user_dict["MPI"]["share_coulomb_potential"]
+            "shared_memory": user_dict["MPI"]["share_coulomb_potential"],
+            "rebuild_interval": user_dict["SCF"]["coulomb_rebuild"]
         }
 
     # Exchange
     if wf_method in ['hf', 'dft']:
         fock_dict["exchange_operator"] = {
             "poisson_prec": user_dict["Precisions"]["poisson_prec"],
-            "exchange_prec": user_dict["Precisions"]["exchange_prec"]
+            "exchange_prec": user_dict["Precisions"]["exchange_prec"],
+            "screening": user_dict["WaveFunction"]["exchange_screening"],
+            "shared_memory": user_dict["MPI"]["share_exchange_orbitals"],
+            "rebuild_interval": user_dict["SCF"]["exchange_rebuild"],
+            "ace": user_dict["SCF"]["exchange_ace"]
         }
 
     # Exchange-Correlation
@@ -228,8 +234,8 @@ def write_scf_plot(user_dict):
         plot_dict["plotter"] = user_dict["Plotter"]
         if user_dict["world_unit"] == "angstrom":
             plot_dict["plotter"] = {
-                k: [ANGSTROM_2_BOHR * r for r in plot_dict["plotter"][k]]
-                for k in plot_dict["plotter"].keys()
+                k: ([ANGSTROM_2_BOHR * r for r in v] if k in ["O", "A", "B", "C"] else v)
+                for k, v in plot_dict["plotter"].items()
             }
     return plot_dict
 
@@ -297,14 +303,17 @@ def write_rsp_fock(user_dict, mol_dict, wf_method, dft_funcs):
     if wf_method in ['hartree', 'hf', 'dft']:
         fock_dict["coulomb_operator"] = {
             "poisson_prec": user_dict["Precisions"]["poisson_prec"],
-            "shared_memory": user_dict["MPI"]["share_coulomb_potential"]
+            "shared_memory": user_dict["MPI"]["share_coulomb_potential"],
+            "rebuild_interval": user_dict["Response"]["coulomb_rebuild"]
         }
 
     # Exchange
     if wf_method in ['hf', 'dft']:
         fock_dict["exchange_operator"] = {
             "poisson_prec": user_dict["Precisions"]["poisson_prec"],
-            "exchange_prec": user_dict["Precisions"]["exchange_prec"]
+            "exchange_prec": user_dict["Precisions"]["exchange_prec"],
+            "screening": user_dict["WaveFunction"]["exchange_screening"],
+            "pre_compute": user_dict["Response"]["exchange_precompute"]
         }
 
     # Exchange-Correlation
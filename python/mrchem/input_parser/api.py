@@ -172,6 +172,12 @@ def stencil() -> JSONDict:
                                                               "'surf', "
                                                               "'cube']"],
                                             'type': 'str'},
+                                        {   'default': 'text',
+                                            'name': 'format',
+                                            'predicates': [   'value.lower() '
+                                                              "in ['text', "
+                                                              "'binary']"],
+                                            'type': 'str'},
                                         {   'default': [20, 20, 20],
                                             'name': 'points',
                                             'predicates': [   'all(p > 0 for p '
@@ -222,8 +228,14 @@ def stencil() -> JSONDict:
                                         {   'default': False,
                                             'name': 'share_xc_potential',
                                             'type': 'bool'},
+                                        {   'default': False,
+                                            'name': 'share_exchange_orbitals',
+                                            'type': 'bool'},
                                         {   'default': -1,
                                             'name': 'bank_size',
+                                            'type': 'int'},
+                                        {   'default': -1,
+                                            'name': 'memory_budget',
                                             'type': 'int'}],
                         'name': 'MPI'},
                     {   'keywords': [   {   'default': -1,
@@ -277,11 +289,15 @@ def stencil() -> JSONDict:
                                                               "'b3lyp', "
                                                               "'b3lyp-g', "
                                                               "'olyp', 'kt1', "
-                                                              "'kt2', 'kt3']"],
+                                                              "'kt2', 'kt3', "
+                                                              "'camb3lyp']"],
                                             'type': 'str'},
                                         {   'default': True,
                                             'name': 'restricted',
-                                            'type': 'bool'}],
+                                            'type': 'bool'},
+                                        {   'default': 0.0,
+                                            'name': 'exchange_screening',
+                                            'type': 'float'}],
                         'name': 'WaveFunction'},
                     {   'keywords': [   {   'default': 0.0,
                                             'name': 'density_cutoff',
@@ -391,6 +407,15 @@ def stencil() -> JSONDict:
                                         {   'default': False,
                                             'name': 'localize',
                                             'type': 'bool'},
+                                        {   'default': 0,
+                                            'name': 'exchange_rebuild',
+                                            'type': 'int'},
+                                        {   'default': False,
+                                            'name': 'exchange_ace',
+                                            'type': 'bool'},
+                                        {   'default': 0,
+                                            'name': 'coulomb_rebuild',
+                                            'type': 'int'},
                                         {   'default': -1.0,
                                             'name': 'energy_thrs',
                                             'type': 'float'},
@@ -481,13 +506,19 @@ def stencil() -> JSONDict:
                                             'name': 'path_orbitals',
                                             'predicates': ["value[-1] != '/'"],
                                             'type': 'str'},
+                                        {   'default': True,
+                                            'name': 'exchange_precompute',
+                                            'type': 'bool'},
                                         {   'default': '10 * '
                                                        "user['world_prec']",
                                             'name': 'orbital_thrs',
                                             'type': 'float'},
                                         {   'default': "user['SCF']['localize']",
                                             'name': 'localize',
-                                            'type': 'bool'}],
+                                            'type': 'bool'},
+                                        {   'default': "user['SCF']['coulomb_rebuild']",
+                                            'name': 'coulomb_rebuild',
+                                            'type': 'int'}],
                         'name': 'Response'},
                     {   'keywords': [   {   'default': 100,
                                             'name': 'max_iter',
@@ -181,6 +181,33 @@ double HydrogenFunction::evalf(const mrcpp::Coord<3> &p) const {
     return this->R.evalf(r) * this->Y.evalf(q);
 }
 
+/** @brief Evaluate the function in a block of points
+ *
+ * @param n: number of points
+ * @param x,y,z: coordinates of the points
+ * @param out: function values, length n
+ *
+ * The exponential is evaluated in a separate pass over all points, which
+ * vectorizes, while the (branching) polynomial parts are done point by point.
+ */
+void HydrogenFunction::evalBatch(int n, const double *x, const double *y, const double *z, double *out) const {
+    const mrcpp::Coord<3> &o = this->origin;
+    const double c_1 = this->R.c_1;
+    const double c_0 = this->R.c_0 * this->Y.c_0;
+#pragma omp simd
+    for (int p = 0; p < n; p++) {
+        double dx = x[p] - o[0];
+        double dy = y[p] - o[1];
+        double dz = z[p] - o[2];
+        out[p] = std::exp(-0.5 * c_1 * std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+    for (int p = 0; p < n; p++) {
+        mrcpp::Coord<3> q{x[p] - o[0], y[p] - o[1], z[p] - o[2]};
+        double rho = c_1 * std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2]);
+        out[p] *= c_0 * this->R.evalfPoly(rho) * this->Y.evalfPoly(q);
+    }
+}
+
 // Copied from mrcpp::Gaussian
 bool HydrogenFunction::isZeroOnInterval(const double *a, const double *b) const {
     bool outside = true;
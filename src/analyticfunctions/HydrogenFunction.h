@@ -57,6 +57,8 @@ public:
 
     double evalf(const mrcpp::Coord<3> &r) const override;
 
+    friend class HydrogenFunction;
+
 protected:
     const int L;
     const int M;
@@ -72,6 +74,7 @@ public:
     HydrogenFunction(int n, int l, int m, double Z, const mrcpp::Coord<3> &o);
 
     double evalf(const mrcpp::Coord<3> &r) const override;
+    void evalBatch(int n, const double *x, const double *y, const double *z, double *out) const;
 
 protected:
     mrcpp::Coord<3> origin;
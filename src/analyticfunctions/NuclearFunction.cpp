@@ -23,31 +23,472 @@
  * <https://mrchem.readthedocs.io/>
  */
 
+#include <algorithm>
+
 #include "NuclearFunction.h"
 #include "chemistry/Nucleus.h"
 #include "utils/math_utils.h"
 
 namespace mrchem {
 
+namespace {
+// Smoothing is below machine precision beyond r = 6*S
+const double smooth_cutoff = 6.0;
+// Max number of nuclei in a leaf cluster
+const int leaf_size = 16;
+// Max depth of the cluster tree (size of the traversal stack)
+const int max_depth = 64;
+// Order of the multipole expansions
+const int mp_order = 12;
+const int mp_size = (mp_order + 1) * (mp_order + 2) / 2;
+
+inline int mp_index(int l, int m) {
+    return l * (l + 1) / 2 + m;
+}
+
+/** Regular solid harmonics r^l P_l^m(cos(theta)) exp(i*m*phi), l <= order, m >= 0, by
+ *  the Legendre recursion on the homogeneous polynomials r^(l-m) d^m/dx^m P_l(z/r) */
+void calc_solid_harmonics(int order, double x, double y, double z, std::complex<double> *out) {
+    double r2 = x * x + y * y + z * z;
+    std::complex<double> xy_m(1.0, 0.0);
+    double Q_mm = 1.0;
+    for (int m = 0; m <= order; m++) {
+        if (m > 0) {
+            xy_m *= std::complex<double>(x, y);
+            Q_mm *= 2.0 * m - 1.0;
+        }
+        double Q_0 = Q_mm;
+        double Q_1 = (2.0 * m + 1.0) * z * Q_mm;
+        out[mp_index(m, m)] = Q_0 * xy_m;
+        if (m < order) out[mp_index(m + 1, m)] = Q_1 * xy_m;
+        for (int l = m + 1; l < order; l++) {
+            double Q_2 = ((2.0 * l + 1.0) * z * Q_1 - (l + m) * r2 * Q_0) / (l - m + 1.0);
+            out[mp_index(l + 1, m)] = Q_2 * xy_m;
+            Q_0 = Q_1;
+            Q_1 = Q_2;
+        }
+    }
+}
+/** Potential of the multipole moments M (to the given order) at distance (dx, dy, dz) from
+ *  the expansion center, sum_lm Re(M_lm*S_lm(d))/d^(2l+1) */
+double eval_multipole(int order, const std::complex<double> *M, double dx, double dy, double dz) {
+    std::complex<double> S[mp_size];
+    calc_solid_harmonics(order, dx, dy, dz, S);
+    double d2_inv = 1.0 / (dx * dx + dy * dy + dz * dz);
+    double d_l = std::sqrt(d2_inv);
+    double V = 0.0;
+    for (int l = 0; l <= order; l++) {
+        double V_l = 0.0;
+        for (int m = 0; m <= l; m++) V_l += std::real(M[mp_index(l, m)] * S[mp_index(l, m)]);
+        V += V_l * d_l;
+        d_l *= d2_inv;
+    }
+    return V;
+}
+
+/** Lowest multipole order for which a cluster of radius a at distance d fulfills the
+ *  error bound of setFarFieldPrecision, or -1 if the cluster must be opened */
+int calc_multipole_order(double a, double d, double prec) {
+    double t = a / d;
+    double err = t * d / (d - a);
+    for (int l = 0; l <= mp_order; l++, err *= t) {
+        if (err < prec) return l;
+    }
+    return -1;
+}
+} // namespace
+
 void NuclearFunction::push_back(const Nucleus &nuc, double c) {
     this->nuclei.push_back(nuc);
     this->smooth.push_back(c);
+
+    const mrcpp::Coord<3> &R = nuc.getCoord();
+    auto pos = std::upper_bound(this->x_sorted.begin(), this->x_sorted.end(), R[0]) - this->x_sorted.begin();
+    this->x_sorted.insert(this->x_sorted.begin() + pos, R[0]);
+    this->y_sorted.insert(this->y_sorted.begin() + pos, R[1]);
+    this->z_sorted.insert(this->z_sorted.begin() + pos, R[2]);
+    this->Z_sorted.insert(this->Z_sorted.begin() + pos, nuc.getCharge());
+    this->S_sorted.insert(this->S_sorted.begin() + pos, c);
+    this->r_cutoff = std::max(this->r_cutoff, smooth_cutoff * c);
+
+    // Cluster tree is no longer valid
+    this->clusters.clear();
+    this->cluster_moments.clear();
+    this->x_tree.clear();
+    this->y_tree.clear();
+    this->z_tree.clear();
+    this->Z_tree.clear();
+    this->S_tree.clear();
 }
 
+/** @brief Use multipole expansions for distant groups of nuclei
+ *
+ * @param prec: Relative error allowed for each multipole contribution
+ *
+ * The nuclei are recursively split in two along the longest side of their
+ * bounding box, and each cluster gets the multipole moments (to order
+ * mp_order) around its center of charge. A cluster is evaluated through its
+ * moments if it lies outside the smoothing cutoff and the truncation error
+ * estimate q_abs/(d - a)*(a/d)^(l + 1) is below prec times q_abs/d for some
+ * order l <= mp_order, where a is the cluster radius and d the distance to its
+ * center. The lowest such order is used. For nuclei of equal sign the error is
+ * then below prec relative to the total potential, in line with the relative
+ * precision of the projection. In evalBatch the same bound decides which
+ * clusters enter a local expansion around the block of points. Must be called after all nuclei have been
+ * added, push_back invalidates the cluster tree. A negative precision gives the
+ * exact evaluation.
+ */
+void NuclearFunction::setFarFieldPrecision(double prec) {
+    this->far_prec = prec;
+    this->clusters.clear();
+    this->cluster_moments.clear();
+    this->x_tree.clear();
+    this->y_tree.clear();
+    this->z_tree.clear();
+    this->Z_tree.clear();
+    this->S_tree.clear();
+    int N = this->x_sorted.size();
+    if (prec < 0.0 or N <= leaf_size) return;
+
+    std::vector<int> nuc_idx(N);
+    for (int i = 0; i < N; i++) nuc_idx[i] = i;
+    buildCluster(nuc_idx, 0, N);
+
+    for (int i : nuc_idx) {
+        this->x_tree.push_back(this->x_sorted[i]);
+        this->y_tree.push_back(this->y_sorted[i]);
+        this->z_tree.push_back(this->z_sorted[i]);
+        this->Z_tree.push_back(this->Z_sorted[i]);
+        this->S_tree.push_back(this->S_sorted[i]);
+    }
+}
+
+/** @brief Recursive setup of the cluster containing nuclei nuc_idx[first, last) */
+int NuclearFunction::buildCluster(std::vector<int> &nuc_idx, int first, int last) {
+    const auto &x = this->x_sorted;
+    const auto &y = this->y_sorted;
+    const auto &z = this->z_sorted;
+    const auto &Z = this->Z_sorted;
+
+    Cluster cl;
+    cl.first = first;
+    cl.last = last;
+    cl.child[0] = -1;
+    cl.child[1] = -1;
+    cl.q_abs = 0.0;
+    cl.c = {0.0, 0.0, 0.0};
+    mrcpp::Coord<3> box_min{x[nuc_idx[first]], y[nuc_idx[first]], z[nuc_idx[first]]};
+    mrcpp::Coord<3> box_max = box_min;
+    for (int n = first; n < last; n++) {
+        int i = nuc_idx[n];
+        mrcpp::Coord<3> R_i{x[i], y[i], z[i]};
+        for (int d = 0; d < 3; d++) {
+            box_min[d] = std::min(box_min[d], R_i[d]);
+            box_max[d] = std::max(box_max[d], R_i[d]);
+            cl.c[d] += std::abs(Z[i]) * R_i[d];
+        }
+        cl.q_abs += std::abs(Z[i]);
+    }
+    for (int d = 0; d < 3; d++) cl.c[d] = (cl.q_abs > 0.0) ? cl.c[d] / cl.q_abs : 0.5 * (box_min[d] + box_max[d]);
+
+    // Moments are scaled such that the potential is sum_lm Re(M_lm*S_lm(d))/d^(2l+1)
+    double fac[2 * mp_order + 1];
+    fac[0] = 1.0;
+    for (int k = 1; k <= 2 * mp_order; k++) fac[k] = k * fac[k - 1];
+
+    cl.radius = 0.0;
+    std::complex<double> S[mp_size];
+    std::vector<std::complex<double>> M(mp_size, 0.0);
+    for (int n = first; n < last; n++) {
+        int i = nuc_idx[n];
+        double sx = x[i] - cl.c[0];
+        double sy = y[i] - cl.c[1];
+        double sz = z[i] - cl.c[2];
+        cl.radius = std::max(cl.radius, std::sqrt(sx * sx + sy * sy + sz * sz));
+        calc_solid_harmonics(mp_order, sx, sy, sz, S);
+        for (int k = 0; k < mp_size; k++) M[k] += Z[i] * std::conj(S[k]);
+    }
+    for (int l = 0; l <= mp_order; l++) {
+        for (int m = 0; m <= l; m++) M[mp_index(l, m)] *= ((m == 0) ? 1.0 : 2.0) * fac[l - m] / fac[l + m];
+    }
+
+    int idx = this->clusters.size();
+    this->clusters.push_back(cl);
+    this->cluster_moments.insert(this->cluster_moments.end(), M.begin(), M.end());
+    if (last - first <= leaf_size) return idx;
+
+    // Split at the median along the longest side of the bounding box
+    int dim = 0;
+    for (int d = 1; d < 3; d++) {
+        if (box_max[d] - box_min[d] > box_max[dim] - box_min[dim]) dim = d;
+    }
+    const auto &coord = (dim == 0) ? x : ((dim == 1) ? y : z);
+    int mid = (first + last) / 2;
+    std::nth_element(nuc_idx.begin() + first,
+                     nuc_idx.begin() + mid,
+                     nuc_idx.begin() + last,
+                     [&coord](int i, int j) { return coord[i] < coord[j]; });
+    int child_0 = buildCluster(nuc_idx, first, mid);
+    int child_1 = buildCluster(nuc_idx, mid, last);
+    this->clusters[idx].child[0] = child_0;
+    this->clusters[idx].child[1] = child_1;
+    return idx;
+}
+
+/** @brief Evaluate the potential in a point
+ *
+ * The nuclei within r_cutoff along x form a contiguous range in the sorted arrays,
+ * these get the smoothed potential, the ones outside get the bare Coulomb form.
+ */
 double NuclearFunction::evalf(const mrcpp::Coord<3> &r) const {
+    if (this->clusters.size() > 0) return evalfClusters(r);
+
     double c = -1.0 / (3.0 * mrcpp::root_pi);
+    int N = this->x_sorted.size();
+    const double *x = this->x_sorted.data();
+    const double *y = this->y_sorted.data();
+    const double *z = this->z_sorted.data();
+    const double *Z = this->Z_sorted.data();
+    const double *S = this->S_sorted.data();
+
+    auto lo = std::lower_bound(x, x + N, r[0] - this->r_cutoff) - x;
+    auto hi = std::upper_bound(x + lo, x + N, r[0] + this->r_cutoff) - x;
+
     double result = 0.0;
-    for (int i = 0; i < this->nuclei.size(); i++) {
-        double S_i = this->smooth[i];
-        double Z_i = this->nuclei[i].getCharge();
-        const mrcpp::Coord<3> &R = this->nuclei[i].getCoord();
-        double R1 = math_utils::calc_distance(R, r) / S_i;
+    for (int i = lo; i < hi; i++) {
+        double dx = r[0] - x[i];
+        double dy = r[1] - y[i];
+        double dz = r[2] - z[i];
+        double R1 = std::sqrt(dx * dx + dy * dy + dz * dz) / S[i];
         double partResult = -std::erf(R1) / R1 + c * (std::exp(-R1 * R1) + 16.0 * std::exp(-4.0 * R1 * R1));
-        result += Z_i * partResult / S_i;
+        result += Z[i] * partResult / S[i];
+    }
+    double far = 0.0;
+    for (int i = 0; i < lo; i++) {
+        double dx = r[0] - x[i];
+        double dy = r[1] - y[i];
+        double dz = r[2] - z[i];
+        far -= Z[i] / std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+    for (int i = hi; i < N; i++) {
+        double dx = r[0] - x[i];
+        double dy = r[1] - y[i];
+        double dz = r[2] - z[i];
+        far -= Z[i] / std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+    return result + far;
+}
+
+/** @brief Evaluate the potential in a point using the cluster tree
+ *
+ * Clusters that pass the acceptance test of setFarFieldPrecision contribute
+ * through their multipole moments, the nuclei of the remaining leaf clusters
+ * are evaluated directly.
+ */
+double NuclearFunction::evalfClusters(const mrcpp::Coord<3> &r) const {
+    double c = -1.0 / (3.0 * mrcpp::root_pi);
+    double result = 0.0;
+
+    int stack[max_depth];
+    int n_stack = 0;
+    stack[n_stack++] = 0;
+    while (n_stack > 0) {
+        int idx = stack[--n_stack];
+        const Cluster &cl = this->clusters[idx];
+        double dx = r[0] - cl.c[0];
+        double dy = r[1] - cl.c[1];
+        double dz = r[2] - cl.c[2];
+        double d = std::sqrt(dx * dx + dy * dy + dz * dz);
+        double a = cl.radius;
+
+        // Leaves are cheaper to evaluate directly than through the expansion
+        int order = -1;
+        if (cl.child[0] >= 0 and d - a > this->r_cutoff) order = calc_multipole_order(a, d, this->far_prec);
+
+        if (order >= 0) {
+            result -= eval_multipole(order, &this->cluster_moments[idx * mp_size], dx, dy, dz);
+        } else if (cl.child[0] >= 0) {
+            stack[n_stack++] = cl.child[0];
+            stack[n_stack++] = cl.child[1];
+        } else if (d - a > this->r_cutoff) {
+            const double *x = this->x_tree.data();
+            const double *y = this->y_tree.data();
+            const double *z = this->z_tree.data();
+            const double *Z = this->Z_tree.data();
+            double V = 0.0;
+#pragma omp simd reduction(+ : V)
+            for (int i = cl.first; i < cl.last; i++) {
+                double rx = r[0] - x[i];
+                double ry = r[1] - y[i];
+                double rz = r[2] - z[i];
+                V += Z[i] / std::sqrt(rx * rx + ry * ry + rz * rz);
+            }
+            result -= V;
+        } else {
+            for (int i = cl.first; i < cl.last; i++) {
+                double rx = r[0] - this->x_tree[i];
+                double ry = r[1] - this->y_tree[i];
+                double rz = r[2] - this->z_tree[i];
+                double R = std::sqrt(rx * rx + ry * ry + rz * rz);
+                double S = this->S_tree[i];
+                if (R < smooth_cutoff * S) {
+                    double R1 = R / S;
+                    double partResult = -std::erf(R1) / R1 + c * (std::exp(-R1 * R1) + 16.0 * std::exp(-4.0 * R1 * R1));
+                    result += this->Z_tree[i] * partResult / S;
+                } else {
+                    result -= this->Z_tree[i] / R;
+                }
+            }
+        }
     }
     return result;
 }
 
+/** @brief Evaluate the potential in a block of points
+ *
+ * @param n: number of points
+ * @param x,y,z: coordinates of the points
+ * @param out: function values, length n
+ *
+ * The loop over points is innermost to allow vectorization, the smoothed
+ * form is only used for points within r_cutoff of each nucleus.
+ */
+void NuclearFunction::evalBatch(int n, const double *x, const double *y, const double *z, double *out) const {
+    for (int p = 0; p < n; p++) out[p] = 0.0;
+    if (this->clusters.size() > 0) {
+        evalBatchClusters(n, x, y, z, out);
+        return;
+    }
+
+    double c = -1.0 / (3.0 * mrcpp::root_pi);
+    for (int i = 0; i < this->x_sorted.size(); i++) {
+        double x_i = this->x_sorted[i];
+        double y_i = this->y_sorted[i];
+        double z_i = this->z_sorted[i];
+        double Z_i = this->Z_sorted[i];
+        double S_i = this->S_sorted[i];
+        double R_c = smooth_cutoff * S_i;
+#pragma omp simd
+        for (int p = 0; p < n; p++) {
+            double dx = x[p] - x_i;
+            double dy = y[p] - y_i;
+            double dz = z[p] - z_i;
+            double R = std::sqrt(dx * dx + dy * dy + dz * dz);
+            double R1 = R / S_i;
+            double partResult = -1.0 / R;
+            if (R < R_c) {
+                partResult = (-std::erf(R1) / R1 + c * (std::exp(-R1 * R1) + 16.0 * std::exp(-4.0 * R1 * R1))) / S_i;
+            }
+            out[p] += Z_i * partResult;
+        }
+    }
+}
+
+/** @brief Evaluate the potential in a block of points using the cluster tree
+ *
+ * The cluster tree is traversed once for the whole block. A cluster is far from
+ * the block if all its nuclei are at least d > b + r_cutoff from the center of the
+ * bounding sphere (radius b) of the points, and the truncation error estimate of
+ * setFarFieldPrecision (with the roles of a and b swapped) holds for some order.
+ * The far nuclei are collected in a single local expansion around the center,
+ *
+ * V(p) = sum_lm Re(L_lm*S_lm(p - c)),  L_lm = -sum_i Z_i conj(S_lm(R_i - c))/|R_i - c|^(2l+1)
+ *
+ * (up to the normalization of the moments), which is evaluated once in each point.
+ * The nuclei of the remaining leaf clusters are evaluated directly with the point
+ * loop innermost. The result is added to out.
+ */
+void NuclearFunction::evalBatchClusters(int n, const double *x, const double *y, const double *z, double *out) const {
+    if (n < 1) return;
+    double c = -1.0 / (3.0 * mrcpp::root_pi);
+
+    mrcpp::Coord<3> p_min{x[0], y[0], z[0]};
+    mrcpp::Coord<3> p_max = p_min;
+    for (int p = 1; p < n; p++) {
+        p_min = {std::min(p_min[0], x[p]), std::min(p_min[1], y[p]), std::min(p_min[2], z[p])};
+        p_max = {std::max(p_max[0], x[p]), std::max(p_max[1], y[p]), std::max(p_max[2], z[p])};
+    }
+    mrcpp::Coord<3> p_c;
+    for (int d = 0; d < 3; d++) p_c[d] = 0.5 * (p_min[d] + p_max[d]);
+    double b = 0.5 * math_utils::calc_distance(p_min, p_max);
+
+    int loc_order = -1;
+    std::complex<double> S[mp_size];
+    std::complex<double> L[mp_size];
+    for (int k = 0; k < mp_size; k++) L[k] = 0.0;
+
+    int stack[max_depth];
+    int n_stack = 0;
+    stack[n_stack++] = 0;
+    while (n_stack > 0) {
+        int idx = stack[--n_stack];
+        const Cluster &cl = this->clusters[idx];
+        double d_min = math_utils::calc_distance(p_c, cl.c) - cl.radius;
+        bool is_far = (d_min - b > this->r_cutoff);
+
+        int order = -1;
+        if (is_far) order = calc_multipole_order(b, d_min, this->far_prec);
+
+        if (order >= 0) {
+            for (int i = cl.first; i < cl.last; i++) {
+                double rx = this->x_tree[i] - p_c[0];
+                double ry = this->y_tree[i] - p_c[1];
+                double rz = this->z_tree[i] - p_c[2];
+                double R2_inv = 1.0 / (rx * rx + ry * ry + rz * rz);
+                double Z_l = this->Z_tree[i] * std::sqrt(R2_inv);
+                calc_solid_harmonics(order, rx, ry, rz, S);
+                for (int l = 0; l <= order; l++) {
+                    for (int m = 0; m <= l; m++) L[mp_index(l, m)] += Z_l * std::conj(S[mp_index(l, m)]);
+                    Z_l *= R2_inv;
+                }
+            }
+            loc_order = std::max(loc_order, order);
+        } else if (cl.child[0] >= 0) {
+            stack[n_stack++] = cl.child[0];
+            stack[n_stack++] = cl.child[1];
+        } else {
+            for (int i = cl.first; i < cl.last; i++) {
+                double x_i = this->x_tree[i];
+                double y_i = this->y_tree[i];
+                double z_i = this->z_tree[i];
+                double Z_i = this->Z_tree[i];
+                double S_i = this->S_tree[i];
+                double R_c = (is_far) ? 0.0 : smooth_cutoff * S_i;
+#pragma omp simd
+                for (int p = 0; p < n; p++) {
+                    double dx = x[p] - x_i;
+                    double dy = y[p] - y_i;
+                    double dz = z[p] - z_i;
+                    double R = std::sqrt(dx * dx + dy * dy + dz * dz);
+                    double partResult = -1.0 / R;
+                    if (R < R_c) {
+                        double R1 = R / S_i;
+                        partResult = (-std::erf(R1) / R1 + c * (std::exp(-R1 * R1) + 16.0 * std::exp(-4.0 * R1 * R1))) / S_i;
+                    }
+                    out[p] += Z_i * partResult;
+                }
+            }
+        }
+    }
+    if (loc_order < 0) return;
+
+    // Normalization of the addition theorem, and the sign of the attraction
+    double fac[2 * mp_order + 1];
+    fac[0] = 1.0;
+    for (int k = 1; k <= 2 * mp_order; k++) fac[k] = k * fac[k - 1];
+    for (int l = 0; l <= loc_order; l++) {
+        for (int m = 0; m <= l; m++) L[mp_index(l, m)] *= ((m == 0) ? -1.0 : -2.0) * fac[l - m] / fac[l + m];
+    }
+    for (int p = 0; p < n; p++) {
+        calc_solid_harmonics(loc_order, x[p] - p_c[0], y[p] - p_c[1], z[p] - p_c[2], S);
+        double V = 0.0;
+        for (int l = 0; l <= loc_order; l++) {
+            for (int m = 0; m <= l; m++) V += std::real(L[mp_index(l, m)] * S[mp_index(l, m)]);
+        }
+        out[p] += V;
+    }
+}
+
 bool NuclearFunction::isVisibleAtScale(int scale, int nQuadPts) const {
     double minSmooth = 1.0;
     if (this->smooth.size() > 0) minSmooth = *std::min_element(this->smooth.begin(), this->smooth.end());
@@ -61,20 +502,14 @@ bool NuclearFunction::isVisibleAtScale(int scale, int nQuadPts) const {
 }
 
 bool NuclearFunction::isZeroOnInterval(const double *a, const double *b) const {
-    int totSplit = 0;
-    for (int i = 0; i < this->nuclei.size(); i++) {
-        const mrcpp::Coord<3> &R = this->nuclei[i].getCoord();
-        int split = 1;
-        if (a[0] > R[0] or b[0] < R[0]) split = 0;
-        if (a[1] > R[1] or b[1] < R[1]) split = 0;
-        if (a[2] > R[2] or b[2] < R[2]) split = 0;
-        totSplit += split;
-    }
-    if (totSplit == 0) {
-        return true;
-    } else {
+    auto lo = std::lower_bound(this->x_sorted.begin(), this->x_sorted.end(), a[0]) - this->x_sorted.begin();
+    auto hi = std::upper_bound(this->x_sorted.begin() + lo, this->x_sorted.end(), b[0]) - this->x_sorted.begin();
+    for (auto i = lo; i < hi; i++) {
+        if (a[1] > this->y_sorted[i] or b[1] < this->y_sorted[i]) continue;
+        if (a[2] > this->z_sorted[i] or b[2] < this->z_sorted[i]) continue;
         return false;
     }
+    return true;
 }
 
 } // namespace mrchem
@@ -26,6 +26,7 @@
 #pragma once
 
 #include <cmath>
+#include <complex>
 #include <vector>
 
 #include <MRCPP/MWFunctions>
@@ -34,9 +35,29 @@
 
 namespace mrchem {
 
+/** @class NuclearFunction
+ *
+ * @brief Smoothed nuclear attraction potential of a set of point charges
+ *
+ * Each nucleus contributes Z*u(r/S)/S, where S is the smoothing parameter and
+ * u(x) = -erf(x)/x + c*(exp(-x^2) + 16*exp(-4x^2)). Beyond x = 6 the smoothing
+ * is below machine precision, and u(x) = -1/x to working precision.
+ *
+ * The nuclei are kept sorted along x, such that the ones within the smoothing
+ * cutoff of a point (or inside a node) are found by binary search. Only these
+ * are evaluated with the full smoothed form, all others with the bare -Z/r.
+ *
+ * Blocks of points given as separate coordinate arrays can be evaluated in one
+ * call with evalBatch, which loops over the points in the innermost loop.
+ *
+ * For large systems the long-range part can be evaluated through multipole
+ * expansions of groups of nuclei (evalf) or a local expansion around the block
+ * of points (evalBatch), see setFarFieldPrecision.
+ */
 class NuclearFunction final : public mrcpp::RepresentableFunction<3> {
 public:
     double evalf(const mrcpp::Coord<3> &r) const override;
+    void evalBatch(int n, const double *x, const double *y, const double *z, double *out) const;
 
     void push_back(const Nucleus &nuc, double c);
     void push_back(const std::string &atom, const mrcpp::Coord<3> &r, double c) {
@@ -48,12 +69,49 @@ public:
     Nuclei &getNuclei() { return this->nuclei; }
     const Nuclei &getNuclei() const { return this->nuclei; }
 
+    void setFarFieldPrecision(double prec);
+
     bool isVisibleAtScale(int scale, int nQuadPts) const override;
     bool isZeroOnInterval(const double *a, const double *b) const override;
 
 protected:
+    /** Group of nuclei, with multipole moments of the bare point charges
+     *  around its center of charge stored in cluster_moments */
+    struct Cluster {
+        int first;         ///< First nucleus (index into the *_tree arrays)
+        int last;          ///< One past the last nucleus
+        int child[2];      ///< Sub-clusters, negative for leaves
+        double radius;     ///< Largest distance from center to a nucleus
+        double q_abs;      ///< Sum of absolute charges
+        mrcpp::Coord<3> c; ///< Expansion center
+    };
+
     Nuclei nuclei;
     std::vector<double> smooth;
+
+    // Nuclei sorted along x (structure of arrays)
+    std::vector<double> x_sorted;
+    std::vector<double> y_sorted;
+    std::vector<double> z_sorted;
+    std::vector<double> Z_sorted;
+    std::vector<double> S_sorted;
+    double r_cutoff{0.0}; ///< Largest distance where the smoothing is significant
+
+    // Cluster tree for multipole evaluation of the far field
+    double far_prec{-1.0};
+    std::vector<Cluster> clusters;
+    std::vector<std::complex<double>> cluster_moments;
+
+    // Nuclei in cluster order, such that each cluster is a contiguous range
+    std::vector<double> x_tree;
+    std::vector<double> y_tree;
+    std::vector<double> z_tree;
+    std::vector<double> Z_tree;
+    std::vector<double> S_tree;
+
+    int buildCluster(std::vector<int> &nuc_idx, int first, int last);
+    double evalfClusters(const mrcpp::Coord<3> &r) const;
+    void evalBatchClusters(int n, const double *x, const double *y, const double *z, double *out) const;
 };
 
 namespace detail {
@@ -38,7 +38,8 @@
 #include "initial_guess/mw.h"
 #include "initial_guess/sad.h"
 
-#include "utils/MolPlotter.h"
+#include "utils/GridPlotter.h"
+#include "utils/ScopedTimer.h"
 #include "utils/math_utils.h"
 #include "utils/print_utils.h"
 
@@ -47,6 +48,8 @@
 #include "qmfunctions/density_utils.h"
 #include "qmfunctions/orbital_utils.h"
 
+#include "qmoperators/NuclearFieldCache.h"
+#include "qmoperators/OperatorRegistry.h"
 #include "qmoperators/one_electron/ElectricFieldOperator.h"
 #include "qmoperators/one_electron/H_BB_dia.h"
 #include "qmoperators/one_electron/H_BM_dia.h"
@@ -59,6 +62,7 @@
 #include "qmoperators/one_electron/NuclearOperator.h"
 
 #include "qmoperators/two_electron/CoulombOperator.h"
+#include "qmoperators/two_electron/ExchangeKernel.h"
 #include "qmoperators/two_electron/ExchangeOperator.h"
 #include "qmoperators/two_electron/FockOperator.h"
 #include "qmoperators/two_electron/ReactionOperator.h"
@@ -111,6 +115,7 @@ namespace rsp {
 bool guess_orbitals(const json &input, Molecule &mol);
 void write_orbitals(const json &input, Molecule &mol, bool dynamic);
 void calc_properties(const json &input, Molecule &mol, int dir, double omega);
+FockOperator &get_unperturbed_fock(const json &input, Molecule &mol);
 } // namespace rsp
 
 } // namespace driver
@@ -211,6 +216,7 @@ void driver::init_properties(const json &json_prop, Molecule &mol) {
  * This function expects the "scf_calculation" subsection of the input.
  */
 json driver::scf::run(const json &json_scf, Molecule &mol) {
+    ScopedTimer section("scf");
     print_utils::headline(0, "Computing Ground State Wavefunction");
     json json_out = {{"success", true}};
 
@@ -225,7 +231,11 @@ json driver::scf::run(const json &json_scf, Molecule &mol) {
     driver::build_fock_operator(json_fock, mol, F, 0);
 
     // Pre-compute internal exchange contributions
-    if (F.getExchangeOperator()) F.getExchangeOperator()->setPreCompute();
+    if (F.getExchangeOperator()) {
+        F.getExchangeOperator()->setPreCompute();
+        F.getExchangeOperator()->setRebuildInterval(json_fock["exchange_operator"].value("rebuild_interval", 0));
+        if (json_fock["exchange_operator"].value("ace", false)) F.getExchangeOperator()->setACE();
+    }
 
     ///////////////////////////////////////////////////////////
     ///////////////   Setting Up Initial Guess   //////////////
@@ -297,6 +307,7 @@ json driver::scf::run(const json &json_scf, Molecule &mol) {
  * This function expects the "initial_guess" subsection of the input.
  */
 bool driver::scf::guess_orbitals(const json &json_guess, Molecule &mol) {
+    ScopedTimer section("initial_guess");
     auto prec = json_guess["prec"];
     auto zeta = json_guess["zeta"];
     auto type = json_guess["type"];
@@ -412,6 +423,7 @@ void driver::scf::write_orbitals(const json &json_orbs, Molecule &mol) {
  * This includes the diamagnetic contributions to the magnetic response properties.
  */
 void driver::scf::calc_properties(const json &json_prop, Molecule &mol) {
+    ScopedTimer section("properties");
     Timer t_tot, t_lap;
     auto plevel = Printer::getPrintLevel();
     if (plevel == 1) mrcpp::print::header(1, "Computing ground state properties");
@@ -538,10 +550,12 @@ void driver::scf::calc_properties(const json &json_prop, Molecule &mol) {
  * "scf_calculation" input section.
  */
 void driver::scf::plot_quantities(const json &json_plot, Molecule &mol) {
+    ScopedTimer section("plot");
     Timer t_tot, t_lap;
 
     auto path = json_plot["plotter"]["path"].get<std::string>();
     auto type = json_plot["plotter"]["type"].get<std::string>();
+    auto format = json_plot["plotter"]["format"].get<std::string>();
     auto npts = json_plot["plotter"]["points"];
     auto O = json_plot["plotter"]["O"];
     auto A = json_plot["plotter"]["A"];
@@ -560,8 +574,9 @@ void driver::scf::plot_quantities(const json &json_plot, Molecule &mol) {
     if (cube) mrcpp::print::header(1, "CubePlot");
 
     auto &Phi = mol.getOrbitals();
-    MolPlotter plt(mol, O);
+    GridPlotter plt(mol, O);
     plt.setRange(A, B, C);
+    plt.setFormat(format);
 
     if (dens_plot) {
         Density rho(false);
@@ -569,9 +584,9 @@ void driver::scf::plot_quantities(const json &json_plot, Molecule &mol) {
         t_lap.start();
         std::string fname = path + "/rho_t";
         density::compute(-1.0, rho, Phi, DensityType::Total);
-        if (line) plt.linePlot(npts, rho, fname);
-        if (surf) plt.surfPlot(npts, rho, fname);
-        if (cube) plt.cubePlot(npts, rho, fname);
+        if (line) plt.linePlot(npts, rho, fname, true);
+        if (surf) plt.surfPlot(npts, rho, fname, true);
+        if (cube) plt.cubePlot(npts, rho, fname, true);
         rho.free(NUMBER::Total);
         mrcpp::print::time(1, fname, t_lap);
 
@@ -579,27 +594,27 @@ void driver::scf::plot_quantities(const json &json_plot, Molecule &mol) {
             t_lap.start();
             fname = path + "/rho_s";
             density::compute(-1.0, rho, Phi, DensityType::Spin);
-            if (line) plt.linePlot(npts, rho, fname);
-            if (surf) plt.surfPlot(npts, rho, fname);
-            if (cube) plt.cubePlot(npts, rho, fname);
+            if (line) plt.linePlot(npts, rho, fname, true);
+            if (surf) plt.surfPlot(npts, rho, fname, true);
+            if (cube) plt.cubePlot(npts, rho, fname, true);
             mrcpp::print::time(1, fname, t_lap);
             rho.free(NUMBER::Total);
 
             t_lap.start();
             fname = path + "/rho_a";
             density::compute(-1.0, rho, Phi, DensityType::Alpha);
-            if (line) plt.linePlot(npts, rho, fname);
-            if (surf) plt.surfPlot(npts, rho, fname);
-            if (cube) plt.cubePlot(npts, rho, fname);
+            if (line) plt.linePlot(npts, rho, fname, true);
+            if (surf) plt.surfPlot(npts, rho, fname, true);
+            if (cube) plt.cubePlot(npts, rho, fname, true);
             mrcpp::print::time(1, fname, t_lap);
             rho.free(NUMBER::Total);
 
             t_lap.start();
             fname = path + "/rho_b";
             density::compute(-1.0, rho, Phi, DensityType::Beta);
-            if (line) plt.linePlot(npts, rho, fname);
-            if (surf) plt.surfPlot(npts, rho, fname);
-            if (cube) plt.cubePlot(npts, rho, fname);
+            if (line) plt.linePlot(npts, rho, fname, true);
+            if (surf) plt.surfPlot(npts, rho, fname, true);
+            if (cube) plt.cubePlot(npts, rho, fname, true);
             rho.free(NUMBER::Total);
             mrcpp::print::time(1, fname, t_lap);
         }
@@ -651,6 +666,7 @@ void driver::scf::plot_quantities(const json &json_plot, Molecule &mol) {
  * vector of the input.
  */
 json driver::rsp::run(const json &json_rsp, Molecule &mol) {
+    ScopedTimer section("response");
     print_utils::headline(0, "Computing Linear Response Wavefunction");
     json json_out = {{"success", true}};
 
@@ -665,22 +681,7 @@ json driver::rsp::run(const json &json_rsp, Molecule &mol) {
     if (plevel == 1) mrcpp::print::header(1, "Preparing unperturbed system");
 
     const auto &json_unpert = json_rsp["unperturbed"];
-    const auto &unpert_fock = json_unpert["fock_operator"];
-    auto unpert_loc = json_unpert["localize"];
-    auto unpert_prec = json_unpert["precision"];
-
-    auto &Phi = mol.getOrbitals();
-    auto &F_mat = mol.getFockMatrix();
-
-    if (unpert_loc) {
-        orbital::localize(unpert_prec, Phi, F_mat);
-    } else {
-        orbital::diagonalize(unpert_prec, Phi, F_mat);
-    }
-
-    FockOperator F_0;
-    driver::build_fock_operator(unpert_fock, mol, F_0, 0);
-    F_0.setup(unpert_prec);
+    auto &F_0 = rsp::get_unperturbed_fock(json_unpert, mol);
     if (plevel == 1) mrcpp::print::footer(1, t_unpert, 2);
 
     if (json_rsp.contains("properties")) scf::calc_properties(json_rsp["properties"], mol);
@@ -697,6 +698,13 @@ json driver::rsp::run(const json &json_rsp, Molecule &mol) {
     const auto &json_fock_1 = json_rsp["fock_operator"];
     driver::build_fock_operator(json_fock_1, mol, F_1, 1);
 
+    // Pre-compute internal exchange contributions, if requested and within the memory budget,
+    // with the pair potentials of the unperturbed orbitals shared by all response calculations
+    if (F_1.getExchangeOperator() and json_fock_1["exchange_operator"].value("pre_compute", true)) {
+        F_1.getExchangeOperator()->setPreCompute();
+        if (F_0.getExchangeOperator()) F_1.getExchangeOperator()->sharePairs(*F_0.getExchangeOperator());
+    }
+
     const auto &json_pert = json_rsp["perturbation"];
     auto h_1 = driver::get_operator<3>(json_pert["operator"], json_pert);
     json_out["perturbation"] = json_pert["operator"];
@@ -759,7 +767,6 @@ json driver::rsp::run(const json &json_rsp, Molecule &mol) {
         mol.getOrbitalsY().clear(); // Clear orbital vector
         json_out["components"].push_back(comp_out);
     }
-    F_0.clear();
     mpi::barrier(mpi::comm_orb);
     mol.getOrbitalsX_p().reset(); // Release shared_ptr
     mol.getOrbitalsY_p().reset(); // Release shared_ptr
@@ -767,6 +774,63 @@ json driver::rsp::run(const json &json_rsp, Molecule &mol) {
     return json_out;
 }
 
+namespace {
+// Unperturbed Fock operator shared by consecutive response calculations
+Molecule *unpert_mol{nullptr};
+std::string unpert_key;
+std::unique_ptr<FockOperator> unpert_fock;
+} // namespace
+
+/** @brief Return the set up unperturbed Fock operator for a response calculation
+ *
+ * The ground state orbitals are localized (or diagonalized) and the Fock
+ * operator is built and set up from them. The operator is kept for the
+ * following response calculations (frequencies and properties), and as long
+ * as they request the same molecule and the same "unperturbed" input section
+ * it is returned as is, without touching the orbitals again. The operator is
+ * released by rsp::clear.
+ *
+ * This function expects the "unperturbed" subsection of the input.
+ */
+FockOperator &driver::rsp::get_unperturbed_fock(const json &json_unpert, Molecule &mol) {
+    auto key = json_unpert.dump();
+    if (unpert_fock != nullptr and unpert_mol == &mol and unpert_key == key) {
+        println(2, " Reusing unperturbed Fock operator");
+        return *unpert_fock;
+    }
+    rsp::clear();
+
+    const auto &json_fock = json_unpert["fock_operator"];
+    auto unpert_loc = json_unpert["localize"];
+    auto unpert_prec = json_unpert["precision"];
+
+    auto &Phi = mol.getOrbitals();
+    auto &F_mat = mol.getFockMatrix();
+
+    if (unpert_loc) {
+        orbital::localize(unpert_prec, Phi, F_mat);
+    } else {
+        orbital::diagonalize(unpert_prec, Phi, F_mat);
+    }
+
+    auto F_0 = std::make_unique<FockOperator>();
+    driver::build_fock_operator(json_fock, mol, *F_0, 0);
+    F_0->setup(unpert_prec);
+
+    unpert_mol = &mol;
+    unpert_key = key;
+    unpert_fock = std::move(F_0);
+    return *unpert_fock;
+}
+
+/** @brief Release the unperturbed Fock operator kept between response calculations */
+void driver::rsp::clear() {
+    if (unpert_fock != nullptr) unpert_fock->clear();
+    unpert_fock.reset();
+    unpert_mol = nullptr;
+    unpert_key.clear();
+}
+
 /** @brief Run initial guess calculation for the response orbitals
  *
  * This function will update the ground state orbitals and the Fock
@@ -849,6 +913,7 @@ void driver::rsp::write_orbitals(const json &json_orbs, Molecule &mol, bool dyna
  * input section, and will compute all properties which are present in this input.
  */
 void driver::rsp::calc_properties(const json &json_prop, Molecule &mol, int dir, double omega) {
+    ScopedTimer section("properties");
     Timer t_tot, t_lap;
     auto plevel = Printer::getPrintLevel();
     if (plevel == 1) mrcpp::print::header(1, "Computing linear response properties");
@@ -944,7 +1009,7 @@ void driver::build_fock_operator(const json &json_fock, Molecule &mol, FockOpera
         auto proj_prec = json_fock["nuclear_operator"]["proj_prec"];
         auto smooth_prec = json_fock["nuclear_operator"]["smooth_prec"];
         auto shared_memory = json_fock["nuclear_operator"]["shared_memory"];
-        auto V_p = std::make_shared<NuclearOperator>(nuclei, proj_prec, smooth_prec, shared_memory);
+        auto V_p = nuclear_field_cache::potential(nuclei, proj_prec, smooth_prec, shared_memory);
         F.getNuclearOperator() = V_p;
     }
     ///////////////////////////////////////////////////////////
@@ -953,12 +1018,15 @@ void driver::build_fock_operator(const json &json_fock, Molecule &mol, FockOpera
     if (json_fock.contains("coulomb_operator")) {
         auto poisson_prec = json_fock["coulomb_operator"]["poisson_prec"];
         auto shared_memory = json_fock["coulomb_operator"]["shared_memory"];
-        auto P_p = std::make_shared<PoissonOperator>(*MRA, poisson_prec);
+        auto rebuild_interval = json_fock["coulomb_operator"].value("rebuild_interval", 0);
+        auto P_p = operator_registry::poisson(*MRA, poisson_prec);
         if (order == 0) {
             auto J_p = std::make_shared<CoulombOperator>(P_p, Phi_p, shared_memory);
+            J_p->setRebuildInterval(rebuild_interval);
             F.getCoulombOperator() = J_p;
         } else if (order == 1) {
             auto J_p = std::make_shared<CoulombOperator>(P_p, Phi_p, X_p, Y_p, shared_memory);
+            J_p->setRebuildInterval(rebuild_interval);
             F.getCoulombOperator() = J_p;
         } else {
             MSG_ABORT("Invalid perturbation order");
@@ -971,8 +1039,8 @@ void driver::build_fock_operator(const json &json_fock, Molecule &mol, FockOpera
 
         // preparing Reaction Operator
         auto poisson_prec = json_fock["reaction_operator"]["poisson_prec"];
-        auto P_r = std::make_shared<PoissonOperator>(*MRA, poisson_prec);
-        auto D_r = std::make_shared<mrcpp::ABGVOperator<3>>(*MRA, 0.0, 0.0);
+        auto P_r = operator_registry::poisson(*MRA, poisson_prec);
+        auto D_r = operator_registry::derivative(*MRA, "abgv_00");
         auto hist_r = json_fock["reaction_operator"]["kain"];
 
         auto cavity_r = mol.getCavity_p();
@@ -994,6 +1062,9 @@ void driver::build_fock_operator(const json &json_fock, Molecule &mol, FockOpera
     ////////////////////   XC Operator   //////////////////////
     ///////////////////////////////////////////////////////////
     double exx = 1.0;
+    double rs_mu = 0.0;
+    double cam_alpha = 0.0;
+    double cam_beta = 0.0;
     if (json_fock.contains("xc_operator")) {
         auto shared_memory = json_fock["xc_operator"]["shared_memory"];
         auto json_xcfunc = json_fock["xc_operator"]["xc_functional"];
@@ -1013,6 +1084,11 @@ void driver::build_fock_operator(const json &json_fock, Molecule &mol, FockOpera
         }
         auto mrdft_p = xc_factory.build();
         exx = mrdft_p->functional().amountEXX();
+        if (mrdft_p->functional().isRangeSeparated()) {
+            rs_mu = mrdft_p->functional().rangeSepMu();
+            cam_alpha = mrdft_p->functional().camAlpha();
+            cam_beta = mrdft_p->functional().camBeta();
+        }
 
         if (order == 0) {
             auto XC_p = std::make_shared<XCOperator>(mrdft_p, Phi_p, shared_memory);
@@ -1027,12 +1103,24 @@ void driver::build_fock_operator(const json &json_fock, Molecule &mol, FockOpera
     ///////////////////////////////////////////////////////////
     /////////////////   Exchange Operator   ///////////////////
     ///////////////////////////////////////////////////////////
-    if (json_fock.contains("exchange_operator") and exx > mrcpp::MachineZero) {
+    if (json_fock.contains("exchange_operator") and (exx > mrcpp::MachineZero or rs_mu > 0.0)) {
         auto exchange_prec = json_fock["exchange_operator"]["exchange_prec"];
         auto poisson_prec = json_fock["exchange_operator"]["poisson_prec"];
-        auto P_p = std::make_shared<PoissonOperator>(*MRA, poisson_prec);
+        auto screening = json_fock["exchange_operator"].value("screening", 0.0);
+        auto shared_memory = json_fock["exchange_operator"].value("shared_memory", false);
+        exchange_kernel::Kernel_p P_p{nullptr};
+        if (rs_mu > 0.0) {
+            // The CAM weights are carried by the kernel itself
+            if (screening > 0.0) MSG_ABORT("Exchange screening not compatible with range-separated functional");
+            P_p = exchange_kernel::range_separated(*MRA, rs_mu, cam_alpha, cam_beta, poisson_prec);
+            exx = 1.0;
+        } else if (screening > 0.0) {
+            P_p = exchange_kernel::yukawa(*MRA, screening, poisson_prec);
+        } else {
+            P_p = exchange_kernel::coulomb(*MRA, poisson_prec);
+        }
         if (order == 0) {
-            auto K_p = std::make_shared<ExchangeOperator>(P_p, Phi_p, exchange_prec);
+            auto K_p = std::make_shared<ExchangeOperator>(P_p, Phi_p, exchange_prec, shared_memory);
             F.getExchangeOperator() = K_p;
         } else {
             auto K_p = std::make_shared<ExchangeOperator>(P_p, Phi_p, X_p, Y_p, exchange_prec);
@@ -1084,21 +1172,9 @@ template <int I, int J> RankTwoOperator<I, J> driver::get_operator(const std::st
     return h;
 }
 
-/** @brief Construct derivative operator based on input keyword */
+/** @brief Get the (shared) derivative operator based on input keyword */
 DerivativeOperator_p driver::get_derivative(const std::string &name) {
-    DerivativeOperator_p D = nullptr;
-    if (name == "abgv_00") {
-        D = std::make_shared<mrcpp::ABGVOperator<3>>(*MRA, 0.0, 0.0);
-    } else if (name == "abgv_55") {
-        D = std::make_shared<mrcpp::ABGVOperator<3>>(*MRA, 0.5, 0.5);
-    } else if (name == "ph") {
-        D = std::make_shared<mrcpp::PHOperator<3>>(*MRA, 1);
-    } else if (name == "bspline") {
-        D = std::make_shared<mrcpp::BSOperator<3>>(*MRA, 1);
-    } else {
-        MSG_ERROR("Invalid derivative operator");
-    }
-    return D;
+    return operator_registry::derivative(*MRA, name);
 }
 
 json driver::print_properties(const Molecule &mol) {
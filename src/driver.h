@@ -39,7 +39,8 @@ nlohmann::json run(const nlohmann::json &input, Molecule &mol);
 }
 namespace rsp {
 nlohmann::json run(const nlohmann::json &input, Molecule &mol);
-}
+void clear();
+} // namespace rsp
 
 } // namespace driver
 } // namespace mrchem
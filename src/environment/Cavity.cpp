@@ -32,6 +32,11 @@ Cavity::Cavity(std::vector<mrcpp::Coord<3>> &centers, std::vector<double> &radii
         : width(width)
         , radii(radii)
         , centers(centers) {
+    for (const auto &c : this->centers) {
+        this->x_c.push_back(c[0]);
+        this->y_c.push_back(c[1]);
+        this->z_c.push_back(c[2]);
+    }
     setGradVector();
 }
 
@@ -107,15 +112,47 @@ void Cavity::setGradVector() {
  *  @return double value of the Cavity at point \f$\mathbf{r}\f$
  */
 double Cavity::evalf(const mrcpp::Coord<3> &r) const {
+    const int N = this->radii.size();
+    const double *x = this->x_c.data();
+    const double *y = this->y_c.data();
+    const double *z = this->z_c.data();
+    const double *R = this->radii.data();
     double C = 1.0;
-    for (int i = 0; i < centers.size(); i++) {
-        double s = math_utils::calc_distance(centers[i], r) - radii[i];
-        double Theta = 0.5 * (1 + std::erf(s / width));
-        double Ci = 1 - Theta;
-        C *= 1 - Ci;
+#pragma omp simd reduction(* : C)
+    for (int i = 0; i < N; i++) {
+        double dx = r[0] - x[i];
+        double dy = r[1] - y[i];
+        double dz = r[2] - z[i];
+        double s = std::sqrt(dx * dx + dy * dy + dz * dz) - R[i];
+        C *= 0.5 * (1.0 + std::erf(s / this->width));
+    }
+    return 1.0 - C;
+}
+
+/** @brief Evaluates the cavity in a block of 3D points
+ *  @param n number of points
+ *  @param x,y,z coordinates of the points
+ *  @param out values of the Cavity in each point, length n
+ *
+ *  Same as evalf, but with the loop over points innermost such that it can be vectorized.
+ */
+void Cavity::evalBatch(int n, const double *x, const double *y, const double *z, double *out) const {
+    for (int p = 0; p < n; p++) out[p] = 1.0;
+    for (int i = 0; i < this->radii.size(); i++) {
+        double x_i = this->x_c[i];
+        double y_i = this->y_c[i];
+        double z_i = this->z_c[i];
+        double R_i = this->radii[i];
+#pragma omp simd
+        for (int p = 0; p < n; p++) {
+            double dx = x[p] - x_i;
+            double dy = y[p] - y_i;
+            double dz = z[p] - z_i;
+            double s = std::sqrt(dx * dx + dy * dy + dz * dz) - R_i;
+            out[p] *= 0.5 * (1.0 + std::erf(s / this->width));
+        }
     }
-    C = 1 - C;
-    return C;
+    for (int p = 0; p < n; p++) out[p] = 1.0 - out[p];
 }
 
 bool Cavity::isVisibleAtScale(int scale, int nQuadPts) const {
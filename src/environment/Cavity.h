@@ -47,6 +47,7 @@ class Cavity final : public mrcpp::RepresentableFunction<3> {
 public:
     Cavity(std::vector<mrcpp::Coord<3>> &centers, std::vector<double> &radii, double width);
     double evalf(const mrcpp::Coord<3> &r) const override;
+    void evalBatch(int n, const double *x, const double *y, const double *z, double *out) const;
     auto getGradVector() const { return this->gradvector; }
     std::vector<mrcpp::Coord<3>> getCoordinates() const { return centers; } //!< Returns #centers.
     std::vector<double> getRadii() const { return radii; }                  //!< Returns #radii.
@@ -56,6 +57,9 @@ protected:
     double width;                         //!< width of the Cavity boundary.
     std::vector<double> radii;            //!< Contains the radius of each sphere in #Center.
     std::vector<mrcpp::Coord<3>> centers; //!< Contains each of the spheres centered on the nuclei of the Molecule.
+    std::vector<double> x_c;              //!< x coordinates of #centers, contiguous for vectorized evaluation.
+    std::vector<double> y_c;              //!< y coordinates of #centers, contiguous for vectorized evaluation.
+    std::vector<double> z_c;              //!< z coordinates of #centers, contiguous for vectorized evaluation.
     std::vector<std::function<double(const mrcpp::Coord<3> &r)>> gradvector; //< Analytical derivatives of the Cavity.
 
     void setGradVector();
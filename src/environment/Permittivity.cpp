@@ -44,4 +44,13 @@ double Permittivity::evalf(const mrcpp::Coord<3> &r) const {
     }
 }
 
+void Permittivity::evalBatch(int n, const double *x, const double *y, const double *z, double *out) const {
+    this->cavity.evalBatch(n, x, y, z, out);
+    double log_eps = std::log(epsilon_out / epsilon_in);
+    double sign = (inverse) ? -1.0 : 1.0;
+    double fac = (inverse) ? 1.0 / epsilon_in : epsilon_in;
+#pragma omp simd
+    for (int p = 0; p < n; p++) out[p] = fac * std::exp(sign * log_eps * (1.0 - out[p]));
+}
+
 } // namespace mrchem
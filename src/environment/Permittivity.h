@@ -62,6 +62,13 @@ public:
      */
     double evalf(const mrcpp::Coord<3> &r) const override;
 
+    /** @brief Evaluates Permittivity in a block of points, see evalf.
+     *  @param n number of points
+     *  @param x,y,z coordinates of the points
+     *  @param out values of the Permittivity in each point, length n
+     */
+    void evalBatch(int n, const double *x, const double *y, const double *z, double *out) const;
+
     /** @brief Changes the value of #inverse. */
     void flipFunction(bool is_inverse) { this->inverse = is_inverse; }
 
@@ -30,6 +30,7 @@
 #include "chemistry/chemistry_utils.h"
 #include "qmfunctions/density_utils.h"
 #include "qmfunctions/qmfunction_utils.h"
+#include "qmoperators/NuclearFieldCache.h"
 #include "qmoperators/two_electron/ReactionPotential.h"
 #include "scf_solver/KAIN.h"
 #include "utils/print_utils.h"
@@ -74,7 +75,7 @@ SCRF::SCRF(Permittivity e,
         , derivative(D)
         , poisson(P) {
     setDCavity();
-    rho_nuc = chemistry::compute_nuclear_density(this->apply_prec, N, 1000);
+    rho_nuc = nuclear_field_cache::density(this->apply_prec, N, 1000);
 }
 
 SCRF::~SCRF() {
@@ -127,7 +128,10 @@ QMFunction SCRF::solvePoissonEquation(const QMFunction &in_gamma) {
     Vr.alloc(NUMBER::Real);
 
     this->epsilon.flipFunction(true);
-    qmfunction::project(eps_inv, this->epsilon, NUMBER::Real, this->apply_prec / 100);
+    auto eps_batch = [this](int n, const double *x, const double *y, const double *z, double *out) {
+        this->epsilon.evalBatch(n, x, y, z, out);
+    };
+    qmfunction::project(eps_inv, this->epsilon, eps_batch, NUMBER::Real, this->apply_prec / 100);
     this->epsilon.flipFunction(false);
     qmfunction::multiply(first_term, this->rho_tot, eps_inv, this->apply_prec);
     qmfunction::add(rho_eff, 1.0, first_term, -1.0, this->rho_tot, -1.0);
@@ -41,6 +41,7 @@
 #include "qmfunctions/orbital_utils.h"
 #include "qmfunctions/qmfunction_utils.h"
 
+#include "qmoperators/OperatorRegistry.h"
 #include "qmoperators/one_electron/KineticOperator.h"
 #include "qmoperators/one_electron/NuclearOperator.h"
 
@@ -102,7 +103,7 @@ bool initial_guess::core::setup(OrbitalVector &Phi, double prec, const Nuclei &n
 
     // Make Fock operator contributions
     t_lap.start();
-    auto D_p = std::make_shared<mrcpp::ABGVOperator<3>>(*MRA, 0.5, 0.5);
+    auto D_p = operator_registry::derivative(*MRA, "abgv_55");
     KineticOperator T(D_p);
     NuclearOperator V(nucs, prec);
     if (plevel == 1) mrcpp::print::time(1, "Projecting nuclear potential", t_lap);
@@ -205,7 +206,10 @@ void initial_guess::core::project_ao(OrbitalVector &Phi, double prec, const Nucl
                 Phi.push_back(Orbital(SPIN::Paired));
                 Phi.back().setRankID(Phi.size() % mpi::orb_size);
                 if (mpi::my_orb(Phi.back())) {
-                    qmfunction::project(Phi.back(), h_func, NUMBER::Real, prec);
+                    auto h_batch = [&h_func](int n, const double *x, const double *y, const double *z, double *out) {
+                        h_func.evalBatch(n, x, y, z, out);
+                    };
+                    qmfunction::project(Phi.back(), h_func, h_batch, NUMBER::Real, prec);
                     if (std::abs(Phi.back().norm() - 1.0) > 0.01) MSG_WARN("AO not normalized!");
                 }
 
@@ -42,6 +42,7 @@
 #include "qmfunctions/orbital_utils.h"
 #include "qmfunctions/qmfunction_utils.h"
 
+#include "qmoperators/OperatorRegistry.h"
 #include "qmoperators/one_electron/KineticOperator.h"
 #include "qmoperators/one_electron/NuclearOperator.h"
 #include "qmoperators/two_electron/CoulombOperator.h"
@@ -82,8 +83,8 @@ bool initial_guess::sad::setup(OrbitalVector &Phi, double prec, const Nuclei &nu
 
     // Make Fock operator contributions
     t_lap.start();
-    auto P_p = std::make_shared<mrcpp::PoissonOperator>(*MRA, prec);
-    auto D_p = std::make_shared<mrcpp::ABGVOperator<3>>(*MRA, 0.0, 0.0);
+    auto P_p = operator_registry::poisson(*MRA, prec);
+    auto D_p = operator_registry::derivative(*MRA, "abgv_00");
 
     mrdft::Factory xc_factory(*MRA);
     xc_factory.setSpin(false);
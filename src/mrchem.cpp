@@ -35,6 +35,8 @@
 #include "version.h"
 
 #include "chemistry/Molecule.h"
+#include "utils/ScopedTimer.h"
+#include "utils/memory_utils.h"
 
 // Initializing global variables
 mrcpp::MultiResolutionAnalysis<3> *mrchem::MRA;
@@ -63,6 +65,7 @@ int main(int argc, char **argv) {
     json rsp_out = {};
     if (scf_out["success"]) {
         for (auto &i : rsp_inp.items()) rsp_out[i.key()] = driver::rsp::run(i.value(), mol);
+        driver::rsp::clear();
     }
     mpi::barrier(mpi::comm_orb);
     json json_out;
@@ -80,6 +83,10 @@ int main(int argc, char **argv) {
     json_out["scf_calculation"] = scf_out;
     json_out["rsp_calculations"] = rsp_out;
     json_out["properties"] = driver::print_properties(mol);
+    // Timings of the calculation (min/avg/max across ranks)
+    json_out["timings"] = timings::report(mpi::comm_orb);
+    // Memory high-water marks (min/avg/max across ranks)
+    json_out["memory"] = memory_utils::report(mpi::comm_orb);
     // Global success field: true if all requested calculations succeeded
     json_out["success"] = detail::all_success(json_out);
     mrenv::finalize(timer.elapsed());
@@ -25,6 +25,9 @@
 
 #include "Factory.h"
 
+#include <algorithm>
+#include <vector>
+
 #include <MRCPP/MWOperators>
 #include <MRCPP/Printer>
 #include <XCFun/xcfun.h>
@@ -42,6 +45,33 @@ Factory::Factory(const mrcpp::MultiResolutionAnalysis<3> &MRA)
         : mra(MRA)
         , xcfun_p(xcfun_new(), xcfun_delete) {}
 
+/** @brief Add a functional (or set a functional parameter) in XCFun
+ *
+ * Range-separated functionals are recognized by their CAM parameters or by their
+ * attenuated exchange components, in which case the range-separation parameters
+ * are passed on to the exact exchange through the Functional.
+ */
+void Factory::setFunctional(const std::string &n, double c) {
+    const std::vector<std::string> rs_names = {
+        "cam_alpha", "cam_beta", "rangesep_mu", "camb3lyp", "beckecamx", "beckesrx", "ldaerfx", "ldaerfc"};
+    std::string name = n;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if (std::find(rs_names.begin(), rs_names.end(), name) != rs_names.end()) range_sep = true;
+    xcfun_set(xcfun_p.get(), n.c_str(), c);
+}
+
+/** @brief Set the CAM parameters of a range-separated hybrid
+ *
+ * The exact exchange kernel becomes (alpha + beta*erf(mu*r))/r, and the DFT
+ * exchange components in XCFun pick up the complementary part.
+ */
+void Factory::setRangeSeparation(double mu, double alpha, double beta) {
+    xcfun_set(xcfun_p.get(), "rangesep_mu", mu);
+    xcfun_set(xcfun_p.get(), "cam_alpha", alpha);
+    xcfun_set(xcfun_p.get(), "cam_beta", beta);
+    range_sep = true;
+}
+
 /** @brief Build a MRDFT object from the currently defined parameters */
 std::unique_ptr<MRDFT> Factory::build() {
     // Init DFT grid
@@ -80,6 +110,13 @@ std::unique_ptr<MRDFT> Factory::build() {
     if (func_p == nullptr) MSG_ABORT("Invalid functional type");
     func_p->setLogGradient(log_grad);
     func_p->setDensityCutoff(cutoff);
+    if (range_sep) {
+        double mu = 0.0, alpha = 0.0, beta = 0.0;
+        xcfun_get(xcfun_p.get(), "rangesep_mu", &mu);
+        xcfun_get(xcfun_p.get(), "cam_alpha", &alpha);
+        xcfun_get(xcfun_p.get(), "cam_beta", &beta);
+        func_p->setRangeSeparation(mu, alpha, beta);
+    }
 
     auto mrdft_p = std::make_unique<MRDFT>(grid_p, func_p);
     return mrdft_p;
@@ -43,7 +43,8 @@ public:
     void setLogGradient(bool lg) { log_grad = lg; }
     void setDensityCutoff(double c) { cutoff = c; }
     void setDerivative(const std::string &n) { diff_s = n; }
-    void setFunctional(const std::string &n, double c = 1.0) { xcfun_set(xcfun_p.get(), n.c_str(), c); }
+    void setFunctional(const std::string &n, double c = 1.0);
+    void setRangeSeparation(double mu, double alpha, double beta);
 
     std::unique_ptr<MRDFT> build();
 
@@ -52,6 +53,7 @@ private:
     bool spin{false};
     bool gamma{false};
     bool log_grad{false};
+    bool range_sep{false};
     double cutoff{-1.0};
     std::string diff_s{"abgv_00"};
     const mrcpp::MultiResolutionAnalysis<3> mra;
@@ -45,6 +45,11 @@ public:
 
     void setLogGradient(bool log) { log_grad = log; }
     void setDensityCutoff(double cut) { cutoff = cut; }
+    void setRangeSeparation(double mu, double alpha, double beta) {
+        rs_mu = mu;
+        cam_alpha = alpha;
+        cam_beta = beta;
+    }
 
     virtual bool isSpin() const = 0;
     bool isLDA() const { return (not(isGGA() or isMetaGGA())); }
@@ -56,6 +61,10 @@ public:
         xcfun_get(xcfun.get(), "exx", &exx);
         return exx;
     }
+    bool isRangeSeparated() const { return (rs_mu > 0.0); }
+    double rangeSepMu() const { return rs_mu; }
+    double camAlpha() const { return cam_alpha; }
+    double camBeta() const { return cam_beta; }
 
     friend class MRDFT;
 
@@ -63,6 +72,9 @@ protected:
     const int order;
     bool log_grad{false};
     double cutoff{-1.0};
+    double rs_mu{0.0};     ///< Range-separation parameter, zero for global hybrids
+    double cam_alpha{0.0}; ///< Amount of exact exchange at short range
+    double cam_beta{0.0};  ///< Additional exact exchange at long range
     Eigen::VectorXi d_mask;
     Eigen::MatrixXi xc_mask;
     XC_p xcfun;
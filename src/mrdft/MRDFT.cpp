@@ -31,6 +31,7 @@
 #include "Functional.h"
 #include "MRDFT.h"
 #include "utils/Bank.h"
+#include "utils/ScopedTimer.h"
 #include "xc_utils.h"
 
 namespace mrdft {
@@ -60,6 +61,7 @@ namespace mrdft {
  * out_vec[2] = v_xc_b (XC beta potential)
  */
 mrcpp::FunctionTreeVector<3> MRDFT::evaluate(mrcpp::FunctionTreeVector<3> &inp) {
+    mrchem::ScopedTimer section("xc_evaluate");
     mrcpp::Timer timer;
     grid().unify(inp);
     functional().preprocess(inp);
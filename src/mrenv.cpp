@@ -30,6 +30,10 @@
 #include "mrchem.h"
 #include "mrenv.h"
 #include "parallel.h"
+#include "qmoperators/NuclearFieldCache.h"
+#include "qmoperators/OperatorRegistry.h"
+#include "scf_solver/HelmholtzCache.h"
+#include "utils/memory_utils.h"
 #include "utils/print_utils.h"
 #include "version.h"
 
@@ -129,6 +133,7 @@ void mrenv::init_mpi(const json &json_mpi) {
     mpi::numerically_exact = json_mpi["numerically_exact"];
     mpi::shared_memory_size = json_mpi["shared_memory_size"];
     mpi::bank_size = json_mpi["bank_size"];
+    memory_utils::set_budget(json_mpi["memory_budget"]);
     mpi::initialize(); // NB: must be after bank_size and init_mra but before init_printer and print_header
 }
 
@@ -204,7 +209,10 @@ void mrenv::print_header() {
 }
 
 void mrenv::finalize(double wt) {
-    // Delete global MRA
+    // Delete cached operators and fields, and global MRA
+    nuclear_field_cache::clear();
+    operator_registry::clear();
+    helmholtz_cache::clear();
     if (MRA != nullptr) delete MRA;
     MRA = nullptr;
 
@@ -25,6 +25,8 @@
 
 #pragma once
 
+#include <memory>
+
 #include <MRCPP/MWFunctions>
 
 #include "mrchem.h"
@@ -46,24 +48,33 @@ struct FunctionData {
 
 class ComplexFunction final {
 public:
-    explicit ComplexFunction(bool share)
+    explicit ComplexFunction(bool share, int sh_mb = -1)
             : shared_mem_re(nullptr)
             , shared_mem_im(nullptr)
             , re(nullptr)
             , im(nullptr) {
         this->func_data.is_shared = share;
         if (this->func_data.is_shared and mpi::share_size > 1) {
-            // Memory size in MB defined in input. Virtual memory, does not cost anything if not used.
+            // Memory size in MB defined in input, unless given explicitly.
+            // Virtual memory, does not cost anything if not used.
+            if (sh_mb < 0) sh_mb = mpi::shared_memory_size;
 #ifdef MRCPP_HAS_MPI
-            this->shared_mem_re = new mrcpp::SharedMemory(mpi::comm_share, mpi::shared_memory_size);
-            this->shared_mem_im = new mrcpp::SharedMemory(mpi::comm_share, mpi::shared_memory_size);
+            this->shared_mem_re = std::make_shared<mrcpp::SharedMemory>(mpi::comm_share, sh_mb);
+            this->shared_mem_im = std::make_shared<mrcpp::SharedMemory>(mpi::comm_share, sh_mb);
 #endif
         }
     }
 
+    // Both parts are allocated in an existing shared memory block, which can hold several functions
+    explicit ComplexFunction(std::shared_ptr<mrcpp::SharedMemory> sh_mem)
+            : shared_mem_re(sh_mem)
+            , shared_mem_im(sh_mem)
+            , re(nullptr)
+            , im(nullptr) {
+        this->func_data.is_shared = true;
+    }
+
     ~ComplexFunction() {
-        if (this->shared_mem_re != nullptr) delete this->shared_mem_re;
-        if (this->shared_mem_im != nullptr) delete this->shared_mem_im;
         if (this->re != nullptr) delete this->re;
         if (this->im != nullptr) delete this->im;
     }
@@ -72,8 +83,8 @@ public:
 
 private:
     FunctionData func_data;
-    mrcpp::SharedMemory *shared_mem_re;
-    mrcpp::SharedMemory *shared_mem_im;
+    std::shared_ptr<mrcpp::SharedMemory> shared_mem_re;
+    std::shared_ptr<mrcpp::SharedMemory> shared_mem_im;
     mrcpp::FunctionTree<3> *re; ///< Real part of function
     mrcpp::FunctionTree<3> *im; ///< Imaginary part of function
 
@@ -33,8 +33,16 @@
 namespace mrchem {
 extern mrcpp::MultiResolutionAnalysis<3> *MRA; // Global MRA
 
-QMFunction::QMFunction(bool share)
-        : func_ptr(std::make_shared<ComplexFunction>(share)) {}
+/** @brief Constructor
+ *
+ * @param share: allocate the function trees in MPI shared memory
+ * @param sh_mb: size (MB) of each shared memory block, negative means the default size
+ */
+QMFunction::QMFunction(bool share, int sh_mb)
+        : func_ptr(std::make_shared<ComplexFunction>(share, sh_mb)) {}
+
+QMFunction::QMFunction(std::shared_ptr<mrcpp::SharedMemory> sh_mem)
+        : func_ptr(std::make_shared<ComplexFunction>(sh_mem)) {}
 
 QMFunction::QMFunction(const QMFunction &func)
         : conj(func.conj)
@@ -68,24 +76,29 @@ void QMFunction::alloc(int type, mrcpp::MultiResolutionAnalysis<3> *mra) {
     if (mra == nullptr) MSG_ABORT("Invalid argument");
     if (type == NUMBER::Real or type == NUMBER::Total) {
         if (hasReal()) MSG_ABORT("Real part already allocated");
-        this->func_ptr->re = new mrcpp::FunctionTree<3>(*mra, this->func_ptr->shared_mem_re);
+        this->func_ptr->re = new mrcpp::FunctionTree<3>(*mra, this->func_ptr->shared_mem_re.get());
     }
     if (type == NUMBER::Imag or type == NUMBER::Total) {
         if (hasImag()) MSG_ABORT("Imaginary part already allocated");
-        this->func_ptr->im = new mrcpp::FunctionTree<3>(*mra, this->func_ptr->shared_mem_im);
+        this->func_ptr->im = new mrcpp::FunctionTree<3>(*mra, this->func_ptr->shared_mem_im.get());
     }
 }
 
+/** @brief Deallocates the real and/or imaginary parts
+ *
+ * A shared memory block is reset only if it belongs to this function
+ * alone, blocks holding several functions are released with the last of them.
+ */
 void QMFunction::free(int type) {
     if (type == NUMBER::Real or type == NUMBER::Total) {
         if (hasReal()) delete this->func_ptr->re;
         this->func_ptr->re = nullptr;
-        if (this->func_ptr->shared_mem_re) this->func_ptr->shared_mem_re->clear();
+        if (this->func_ptr->shared_mem_re.use_count() == 1) this->func_ptr->shared_mem_re->clear();
     }
     if (type == NUMBER::Imag or type == NUMBER::Total) {
         if (hasImag()) delete this->func_ptr->im;
         this->func_ptr->im = nullptr;
-        if (this->func_ptr->shared_mem_im) this->func_ptr->shared_mem_im->clear();
+        if (this->func_ptr->shared_mem_im.use_count() == 1) this->func_ptr->shared_mem_im->clear();
     }
 }
 
@@ -34,7 +34,8 @@ namespace mrchem {
 
 class QMFunction {
 public:
-    explicit QMFunction(bool share = false);
+    explicit QMFunction(bool share = false, int sh_mb = -1);
+    explicit QMFunction(std::shared_ptr<mrcpp::SharedMemory> sh_mem);
     QMFunction(const QMFunction &func);
     QMFunction &operator=(const QMFunction &func);
     QMFunction dagger();
@@ -30,6 +30,7 @@
 
 #include "parallel.h"
 #include "utils/RRMaximizer.h"
+#include "utils/ScopedTimer.h"
 #include "utils/math_utils.h"
 #include "utils/print_utils.h"
 
@@ -227,6 +228,7 @@ OrbitalVector orbital::add(ComplexDouble a, OrbitalVector &Phi_a, ComplexDouble
  *
  */
 OrbitalVector orbital::rotate(OrbitalVector &Phi, const ComplexMatrix &U, double prec) {
+    ScopedTimer section("rotate");
 
     // The principle of this routine is that nodes are rotated one by one using matrix multiplication.
     // The routine does avoid when possible to move data, but uses pointers and indices manipulation.
@@ -856,6 +858,7 @@ void orbital::orthogonalize(double prec, OrbitalVector &Phi, OrbitalVector &Psi)
  *
  */
 ComplexMatrix orbital::calc_overlap_matrix(OrbitalVector &BraKet) {
+    ScopedTimer section("overlap");
 
     // TODO: spin separate in block?
     int N = BraKet.size();
@@ -1006,6 +1009,7 @@ ComplexMatrix orbital::calc_overlap_matrix(OrbitalVector &BraKet) {
  *
  */
 ComplexMatrix orbital::calc_overlap_matrix(OrbitalVector &Bra, OrbitalVector &Ket) {
+    ScopedTimer section("overlap");
 
     // TODO: spin separate in block?
     int N = Bra.size();
@@ -1352,6 +1356,51 @@ DoubleMatrix orbital::calc_norm_overlap_matrix(OrbitalVector &BraKet) {
     return S;
 }
 
+/** @brief Compute the centroids and spreads of the orbital densities
+ *
+ * Returns a matrix with one row per orbital, with the centroid <r> in the
+ * first three columns and the spread sqrt(<r^2> - <r>^2) in the last column.
+ * The moments are computed from the norms of the end nodes, with the density
+ * taken as uniform within each node. This is accurate to the size of the
+ * nodes, which is small wherever the density is significant.
+ */
+DoubleMatrix orbital::calc_centroids(OrbitalVector &Phi) {
+    int N = Phi.size();
+    DoubleMatrix out = DoubleMatrix::Zero(N, 4);
+    for (int i = 0; i < N; i++) {
+        if (not mpi::my_orb(Phi[i])) continue;
+        double w_tot = 0.0;
+        double r2 = 0.0;
+        mrcpp::Coord<3> r{0.0, 0.0, 0.0};
+        auto add_moments = [&w_tot, &r2, &r](mrcpp::FunctionTree<3> &tree) {
+            for (int n = 0; n < tree.getNEndNodes(); n++) {
+                const auto &node = tree.getEndFuncNode(n);
+                auto w = node.getSquareNorm();
+                auto c = node.getCenter();
+                auto lo = node.getLowerBounds();
+                auto hi = node.getUpperBounds();
+                for (int d = 0; d < 3; d++) {
+                    r[d] += w * c[d];
+                    r2 += w * (c[d] * c[d] + (hi[d] - lo[d]) * (hi[d] - lo[d]) / 12.0);
+                }
+                w_tot += w;
+            }
+        };
+        if (Phi[i].hasReal()) add_moments(Phi[i].real());
+        if (Phi[i].hasImag()) add_moments(Phi[i].imag());
+        if (w_tot <= 0.0) continue;
+
+        double var = r2 / w_tot;
+        for (int d = 0; d < 3; d++) {
+            out(i, d) = r[d] / w_tot;
+            var -= out(i, d) * out(i, d);
+        }
+        out(i, 3) = std::sqrt(std::max(var, 0.0));
+    }
+    mpi::allreduce_matrix(out, mpi::comm_orb);
+    return out;
+}
+
 /** @brief Compute Löwdin orthonormalization matrix
  *
  * @param Phi: orbitals to orthonomalize
@@ -1369,6 +1418,7 @@ ComplexMatrix orbital::calc_lowdin_matrix(OrbitalVector &Phi) {
 }
 
 ComplexMatrix orbital::localize(double prec, OrbitalVector &Phi, ComplexMatrix &F) {
+    ScopedTimer section("localize");
     Timer t_tot;
     auto plevel = Printer::getPrintLevel();
     mrcpp::print::header(2, "Localizing orbitals");
@@ -1457,6 +1507,7 @@ ComplexMatrix orbital::calc_localization_matrix(double prec, OrbitalVector &Phi)
  * The transformation matrix is returned.
  */
 ComplexMatrix orbital::diagonalize(double prec, OrbitalVector &Phi, ComplexMatrix &F) {
+    ScopedTimer section("diagonalize");
     Timer t_tot;
     auto plevel = Printer::getPrintLevel();
     mrcpp::print::header(2, "Digonalizing Fock matrix");
@@ -1492,6 +1543,7 @@ ComplexMatrix orbital::diagonalize(double prec, OrbitalVector &Phi, ComplexMatri
  * Orbitals are rotated in place, and the transformation matrix is returned.
  */
 ComplexMatrix orbital::orthonormalize(double prec, OrbitalVector &Phi, ComplexMatrix &F) {
+    ScopedTimer section("orthonormalize");
     Timer t_tot, t_lap;
     auto plevel = Printer::getPrintLevel();
     mrcpp::print::header(2, "Lowdin orthonormalization");
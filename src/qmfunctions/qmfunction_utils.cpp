@@ -23,8 +23,16 @@
  * <https://mrchem.readthedocs.io/>
  */
 
+#include <array>
+#include <cmath>
+#include <map>
+#include <vector>
+
 #include "MRCPP/Printer"
 #include "MRCPP/Timer"
+#include "MRCPP/treebuilders/TreeBuilder.h"
+#include "MRCPP/treebuilders/TreeCalculator.h"
+#include "MRCPP/treebuilders/WaveletAdaptor.h"
 
 #include "parallel.h"
 
@@ -39,6 +47,125 @@ using mrcpp::Timer;
 namespace mrchem {
 extern mrcpp::MultiResolutionAnalysis<3> *MRA; // Global MRA
 
+namespace {
+using CellKey = std::array<int, 4>; // scale and translation of a node
+using CellMap = qmfunction::CellNormMap;
+
+/** Number of scales below the root scale at which the norms are collected */
+constexpr int screening_depth = 3;
+
+/** @brief Projection where each node is computed from one batch evaluation
+ *
+ * Same as the MRCPP projection, but all the quadrature points of the children
+ * of a node are collected and passed to the batch function in one call.
+ */
+class BatchProjectionCalculator final : public mrcpp::TreeCalculator<3> {
+public:
+    BatchProjectionCalculator(const qmfunction::BatchFunction &f, const std::array<double, 3> &sf)
+            : func(f)
+            , scaling_factor(sf) {}
+
+private:
+    const qmfunction::BatchFunction &func;
+    std::array<double, 3> scaling_factor;
+
+    void calcNode(mrcpp::MWNode<3> &node) override {
+        Eigen::MatrixXd exp_pts;
+        node.getExpandedChildPts(exp_pts);
+        int n_pts = exp_pts.cols();
+        std::vector<double> x(n_pts), y(n_pts), z(n_pts);
+        for (int i = 0; i < n_pts; i++) {
+            x[i] = this->scaling_factor[0] * exp_pts(0, i);
+            y[i] = this->scaling_factor[1] * exp_pts(1, i);
+            z[i] = this->scaling_factor[2] * exp_pts(2, i);
+        }
+        this->func(n_pts, x.data(), y.data(), z.data(), node.getCoefs());
+        node.cvTransform(mrcpp::Backward);
+        node.mwTransform(mrcpp::Compression);
+        node.setHasCoefs();
+        node.calcNorms();
+    }
+};
+
+void project_batch(double prec, FunctionTree<3> &out, mrcpp::RepresentableFunction<3> &f, const qmfunction::BatchFunction &f_batch) {
+    const auto &mra = out.getMRA();
+    mrcpp::build_grid(out, f);
+    mrcpp::TreeBuilder<3> builder;
+    mrcpp::WaveletAdaptor<3> adaptor(prec, mra.getMaxScale());
+    BatchProjectionCalculator calculator(f_batch, mra.getWorldBox().getScalingFactors());
+    builder.build(out, calculator, adaptor, -1);
+    out.mwTransform(mrcpp::BottomUp);
+    out.calcSquareNorm();
+}
+
+CellKey parent_key(const CellKey &key) {
+    CellKey out{key[0] - 1, 0, 0, 0};
+    for (int d = 1; d < 4; d++) out[d] = (key[d] < 0) ? (key[d] - 1) / 2 : key[d] / 2;
+    return out;
+}
+
+/** @brief Collect restricted norms and sup-norm bounds of a tree on coarse cells
+ *
+ * The end nodes are collected on their ancestors at the screening scale (or on
+ * themselves if coarser), and the sums are propagated up to the root nodes.
+ * Within an end node at scale n the function is a polynomial of order k on
+ * each child cell of volume V = 2^{-3(n+1)}, for which the orthonormality of
+ * the scaling basis gives ||f||_inf <= (k+1)^3 / sqrt(V) * ||f||_2.
+ */
+CellMap calc_tree_cell_norms(mrcpp::FunctionTree<3> &tree) {
+    CellMap cells;
+    int root_scale = tree.getRootScale();
+    int screen_scale = root_scale + screening_depth;
+    double kp1 = tree.getKp1();
+    double vol_fac = 1.0;
+    for (int d = 0; d < 3; d++) vol_fac *= tree.getMRA().getWorldBox().getScalingFactors()[d];
+
+    for (int i = 0; i < tree.getNEndNodes(); i++) {
+        auto &node = tree.getEndFuncNode(i);
+        const auto &idx = node.getNodeIndex();
+        int n = idx.getScale();
+        double norm2 = node.getSquareNorm();
+        double sup = kp1 * kp1 * kp1 * std::sqrt(norm2 * std::pow(2.0, 3.0 * (n + 1)) / vol_fac);
+
+        CellKey key{n, idx.getTranslation(0), idx.getTranslation(1), idx.getTranslation(2)};
+        while (key[0] > screen_scale) key = parent_key(key);
+        cells[key].leaf = true;
+        for (; key[0] >= root_scale; key = parent_key(key)) {
+            auto &cell = cells[key];
+            cell.norm2 += norm2;
+            cell.sup = std::max(cell.sup, sup);
+        }
+    }
+    return cells;
+}
+
+/** @brief Upper bound to ||a*b|| from the cell norms of the two trees
+ *
+ * In each cell ||a*b|| <= min(sup(a)*||b||, sup(b)*||a||). The leaf cells of
+ * a are matched with the same cell of b, or with the smallest cell of b that
+ * contains it if b is coarser, in which case the norm of b is over-counted,
+ * which keeps the bound valid.
+ */
+double calc_tree_product_bound(const CellMap &cells_a, const CellMap &cells_b) {
+    double bound2 = 0.0;
+    for (const auto &cell : cells_a) {
+        if (not cell.second.leaf) continue;
+        auto key = cell.first;
+        auto b_it = cells_b.find(key);
+        while (b_it == cells_b.end() and key[0] > cells_b.begin()->first[0]) {
+            key = parent_key(key);
+            b_it = cells_b.find(key);
+        }
+        if (b_it == cells_b.end()) continue;
+        const auto &a = cell.second;
+        const auto &b = b_it->second;
+        double bound = std::min(a.sup * std::sqrt(b.norm2), b.sup * std::sqrt(a.norm2));
+        bound2 += bound * bound;
+    }
+    return std::sqrt(bound2);
+}
+} // namespace
+
 /** @brief Compute <bra|ket> = int bra^\dag(r) * ket(r) dr.
  *
  *  Notice that the <bra| position is already complex conjugated.
@@ -77,6 +204,46 @@ ComplexDouble qmfunction::node_norm_dot(QMFunction bra, QMFunction ket, bool exa
     return ComplexDouble(real_part, imag_part);
 }
 
+/** @brief Norms of a function on the coarse cells used for product screening
+ *
+ * The table only depends on the function itself, so it can be computed once
+ * and reused in calc_product_bound for all the products the function takes
+ * part in. The real and imaginary parts are collected separately.
+ */
+qmfunction::CellNormTable qmfunction::calc_cell_norms(QMFunction inp) {
+    CellNormTable cells;
+    if (inp.hasReal()) cells.push_back(calc_tree_cell_norms(inp.real()));
+    if (inp.hasImag()) cells.push_back(calc_tree_cell_norms(inp.imag()));
+    return cells;
+}
+
+/** @brief A-priori upper bound to the norm of the product ||inp_a * inp_b||
+ *
+ * The bound is computed from the node norms of the two functions on a coarse
+ * common grid, without forming the product. It is meant for screening of
+ * products that are negligible, e.g. pairs of distant localized orbitals. The
+ * real and imaginary parts are bounded separately, and complex conjugation
+ * does not change the bound.
+ */
+double qmfunction::calc_product_bound(QMFunction inp_a, QMFunction inp_b) {
+    return calc_product_bound(calc_cell_norms(inp_a), calc_cell_norms(inp_b));
+}
+
+/** @brief A-priori upper bound to ||a * b|| from precomputed cell norms
+ *
+ * Same bound as above, with the tables from calc_cell_norms.
+ */
+double qmfunction::calc_product_bound(const CellNormTable &cells_a, const CellNormTable &cells_b) {
+    double bound = 0.0;
+    for (const auto &a : cells_a) {
+        for (const auto &b : cells_b) {
+            if (a.empty() or b.empty()) continue;
+            bound += calc_tree_product_bound(a, b);
+        }
+    }
+    return bound;
+}
+
 /** @brief Deep copy
  *
  * Returns a new function which is a full blueprint copy of the input function.
@@ -131,6 +298,25 @@ void qmfunction::project(QMFunction &out, mrcpp::RepresentableFunction<3> &f, in
     mpi::share_function(out, 0, 132231, mpi::comm_share);
 }
 
+/** @brief Projection with batch evaluation of the function
+ *
+ * The grid is initialized from f, like the projection above, while the
+ * coefficients of each node are computed from a single call to f_batch with
+ * all its quadrature points, which allows the point loop to be vectorized.
+ */
+void qmfunction::project(QMFunction &out, mrcpp::RepresentableFunction<3> &f, const BatchFunction &f_batch, int type, double prec) {
+    bool need_to_project = not(out.isShared()) or mpi::share_master();
+    if (type == NUMBER::Real or type == NUMBER::Total) {
+        if (not out.hasReal()) out.alloc(NUMBER::Real);
+        if (need_to_project) project_batch(prec, out.real(), f, f_batch);
+    }
+    if (type == NUMBER::Imag or type == NUMBER::Total) {
+        if (not out.hasImag()) out.alloc(NUMBER::Imag);
+        if (need_to_project) project_batch(prec, out.imag(), f, f_batch);
+    }
+    mpi::share_function(out, 0, 132232, mpi::comm_share);
+}
+
 /** @brief out = a*inp_a + b*inp_b
  *
  * Recast into linear_combination.
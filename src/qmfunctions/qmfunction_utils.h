@@ -25,18 +25,38 @@
 
 #pragma once
 
+#include <array>
+#include <functional>
+#include <map>
+
 #include "mrchem.h"
 #include "qmfunction_fwd.h"
 
 namespace mrchem {
 namespace qmfunction {
 
+/** Norms of a function restricted to the coarse cells used for product screening */
+struct CellNorm {
+    bool leaf{false};  ///< Cell is at the screening scale or is an end node
+    double norm2{0.0}; ///< Squared norm of the function restricted to the cell
+    double sup{0.0};   ///< Upper bound of the function values in the cell
+};
+using CellNormMap = std::map<std::array<int, 4>, CellNorm>; ///< Keyed by scale and translation
+using CellNormTable = std::vector<CellNormMap>;             ///< One map for each of the real and imaginary parts
+
+/** Evaluates a function in n points given as separate coordinate arrays */
+using BatchFunction = std::function<void(int n, const double *x, const double *y, const double *z, double *out)>;
+
 ComplexDouble dot(QMFunction bra, QMFunction ket);
 ComplexDouble node_norm_dot(QMFunction bra, QMFunction ket, bool exact);
+CellNormTable calc_cell_norms(QMFunction inp);
+double calc_product_bound(const CellNormTable &cells_a, const CellNormTable &cells_b);
+double calc_product_bound(QMFunction inp_a, QMFunction inp_b);
 void deep_copy(QMFunction &out, QMFunction &inp);
 void add(QMFunction &out, ComplexDouble a, QMFunction inp_a, ComplexDouble b, QMFunction inp_b, double prec);
 void project(QMFunction &out, std::function<double(const mrcpp::Coord<3> &r)> f, int type, double prec);
 void project(QMFunction &out, mrcpp::RepresentableFunction<3> &f, int type, double prec);
+void project(QMFunction &out, mrcpp::RepresentableFunction<3> &f, const BatchFunction &f_batch, int type, double prec);
 void multiply(QMFunction &out,
               QMFunction inp_a,
               QMFunction inp_b,
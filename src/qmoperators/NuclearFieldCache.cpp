@@ -0,0 +1,85 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+#include <map>
+#include <vector>
+
+#include <MRCPP/Printer>
+
+#include "NuclearFieldCache.h"
+#include "mrchem.h"
+
+#include "chemistry/chemistry_utils.h"
+#include "qmfunctions/Density.h"
+#include "qmoperators/one_electron/NuclearOperator.h"
+
+namespace mrchem {
+
+namespace {
+using FieldKey = std::vector<double>;
+std::map<FieldKey, Density> density_cache;
+std::map<FieldKey, std::shared_ptr<NuclearOperator>> potential_cache;
+
+/** Geometry key: charge and coordinates of each nucleus, followed by the given parameters */
+FieldKey make_key(const Nuclei &nucs, const std::vector<double> &params) {
+    FieldKey key;
+    for (const auto &nuc : nucs) {
+        const auto &R = nuc.getCoord();
+        key.insert(key.end(), {nuc.getCharge(), R[0], R[1], R[2]});
+    }
+    key.insert(key.end(), params.begin(), params.end());
+    return key;
+}
+} // namespace
+
+/** @brief Smeared nuclear density, see chemistry::compute_nuclear_density */
+Density nuclear_field_cache::density(double prec, const Nuclei &nucs, double alpha) {
+    auto key = make_key(nucs, {prec, alpha});
+    auto iter = density_cache.find(key);
+    if (iter == density_cache.end()) {
+        iter = density_cache.emplace(key, chemistry::compute_nuclear_density(prec, nucs, alpha)).first;
+        println(3, " Computed nuclear density (prec " << prec << ")");
+    }
+    return iter->second;
+}
+
+/** @brief Nuclear potential operator, see NuclearOperator */
+std::shared_ptr<NuclearOperator> nuclear_field_cache::potential(const Nuclei &nucs,
+                                                                 double proj_prec,
+                                                                 double smooth_prec,
+                                                                 bool mpi_share) {
+    auto key = make_key(nucs, {proj_prec, smooth_prec, (mpi_share) ? 1.0 : 0.0});
+    auto &V_p = potential_cache[key];
+    if (V_p == nullptr) V_p = std::make_shared<NuclearOperator>(nucs, proj_prec, smooth_prec, mpi_share);
+    return V_p;
+}
+
+/** @brief Release all cached fields */
+void nuclear_field_cache::clear() {
+    density_cache.clear();
+    potential_cache.clear();
+}
+
+} // namespace mrchem
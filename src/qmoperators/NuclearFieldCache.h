@@ -0,0 +1,58 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+#pragma once
+
+#include <memory>
+
+#include "chemistry/Nucleus.h"
+#include "qmfunctions/qmfunction_fwd.h"
+
+/** @file NuclearFieldCache.h
+ *
+ * @brief Process-wide cache of the fields generated by the nuclei
+ *
+ * The smeared nuclear density used by the solvation model and the projected
+ * nuclear potential of the Fock operator are computed once for each geometry
+ * and precision, and shared by all users in the run, e.g. the ground state,
+ * unperturbed and perturbed Fock operators of the SCF and response
+ * calculations. The fields are only read by their users, so they are handed
+ * out as shallow copies (or shared pointers). The cache is cleared before the
+ * MRA is deleted at the end of the run.
+ */
+
+namespace mrchem {
+
+class NuclearOperator;
+
+namespace nuclear_field_cache {
+
+Density density(double prec, const Nuclei &nucs, double alpha);
+std::shared_ptr<NuclearOperator> potential(const Nuclei &nucs, double proj_prec, double smooth_prec, bool mpi_share);
+
+void clear();
+
+} // namespace nuclear_field_cache
+} // namespace mrchem
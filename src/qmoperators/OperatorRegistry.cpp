@@ -0,0 +1,109 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+#include <map>
+#include <tuple>
+
+#include <MRCPP/Printer>
+
+#include "OperatorRegistry.h"
+#include "mrchem.h"
+
+namespace mrchem {
+
+namespace {
+using OperatorKey = std::tuple<std::string, const void *, std::vector<double>, double>;
+std::map<OperatorKey, operator_registry::Convolution_p> convolution_registry;
+std::map<OperatorKey, operator_registry::Derivative_p> derivative_registry;
+} // namespace
+
+/** @brief Poisson operator 1/r */
+std::shared_ptr<mrcpp::PoissonOperator> operator_registry::poisson(const mrcpp::MultiResolutionAnalysis<3> &mra,
+                                                                   double prec) {
+    auto build = [&mra, prec]() -> Convolution_p { return std::make_shared<mrcpp::PoissonOperator>(mra, prec); };
+    return std::static_pointer_cast<mrcpp::PoissonOperator>(convolution("poisson", mra, {}, prec, build));
+}
+
+/** @brief Bound-state Helmholtz operator exp(-mu*r)/r */
+std::shared_ptr<mrcpp::HelmholtzOperator> operator_registry::helmholtz(const mrcpp::MultiResolutionAnalysis<3> &mra,
+                                                                       double mu,
+                                                                       double prec) {
+    if (mu <= 0.0) MSG_ABORT("Invalid Helmholtz parameter");
+    auto build = [&mra, mu, prec]() -> Convolution_p { return std::make_shared<mrcpp::HelmholtzOperator>(mra, mu, prec); };
+    return std::static_pointer_cast<mrcpp::HelmholtzOperator>(convolution("helmholtz", mra, {mu}, prec, build));
+}
+
+/** @brief Generic convolution operator
+ *
+ * @param[in] type name of the kernel, must identify the operator class
+ * @param[in] mra MRA of the operator
+ * @param[in] params kernel parameters
+ * @param[in] prec build precision
+ * @param[in] build constructs the operator if it is not already registered
+ */
+operator_registry::Convolution_p operator_registry::convolution(const std::string &type,
+                                                                const mrcpp::MultiResolutionAnalysis<3> &mra,
+                                                                const std::vector<double> &params,
+                                                                double prec,
+                                                                const std::function<Convolution_p()> &build) {
+    auto key = std::make_tuple(type, static_cast<const void *>(&mra), params, prec);
+    auto &oper = convolution_registry[key];
+    if (oper == nullptr) {
+        oper = build();
+        println(3, " Registered " << type << " operator (prec " << prec << ")");
+    }
+    return oper;
+}
+
+/** @brief Derivative operator by input keyword (abgv_00, abgv_55, ph, bspline) */
+operator_registry::Derivative_p operator_registry::derivative(const mrcpp::MultiResolutionAnalysis<3> &mra,
+                                                              const std::string &name) {
+    auto key = std::make_tuple(name, static_cast<const void *>(&mra), std::vector<double>(), 0.0);
+    auto &oper = derivative_registry[key];
+    if (oper == nullptr) {
+        if (name == "abgv_00") {
+            oper = std::make_shared<mrcpp::ABGVOperator<3>>(mra, 0.0, 0.0);
+        } else if (name == "abgv_55") {
+            oper = std::make_shared<mrcpp::ABGVOperator<3>>(mra, 0.5, 0.5);
+        } else if (name == "ph") {
+            oper = std::make_shared<mrcpp::PHOperator<3>>(mra, 1);
+        } else if (name == "bspline") {
+            oper = std::make_shared<mrcpp::BSOperator<3>>(mra, 1);
+        } else {
+            derivative_registry.erase(key);
+            MSG_ABORT("Invalid derivative operator: " << name);
+        }
+        println(3, " Registered " << name << " derivative operator");
+    }
+    return oper;
+}
+
+/** @brief Release all registered operators (operators still in use are kept alive by their owners) */
+void operator_registry::clear() {
+    convolution_registry.clear();
+    derivative_registry.clear();
+}
+
+} // namespace mrchem
@@ -0,0 +1,74 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <MRCPP/MWOperators>
+
+/** @file OperatorRegistry.h
+ *
+ * @brief Process-wide registry of MRCPP convolution and derivative operators
+ *
+ * Operators are identified by their type, MRA, build precision and parameters,
+ * and each distinct operator is built once and shared by all its users, e.g.
+ * the Poisson operator of the Coulomb, exchange and reaction operators in the
+ * ground state and all response calculations of a run. The registry holds on
+ * to the operators until it is cleared, which happens before the MRA is
+ * deleted at the end of the run.
+ *
+ * Helmholtz operators with orbital dependent parameters are handled separately
+ * by the helmholtz_cache, which rounds the parameters and evicts old operators.
+ *
+ * The operators only live for the duration of the run. Keeping them on disk
+ * between runs would need serialization of the operator trees and a way to
+ * construct a ConvolutionOperator from existing trees, neither of which is
+ * provided by MRCPP. The registry key (type, MRA, precision, parameters) is
+ * what such a cache would be indexed by.
+ */
+
+namespace mrchem {
+namespace operator_registry {
+
+using Convolution_p = std::shared_ptr<mrcpp::ConvolutionOperator<3>>;
+using Derivative_p = std::shared_ptr<mrcpp::DerivativeOperator<3>>;
+
+std::shared_ptr<mrcpp::PoissonOperator> poisson(const mrcpp::MultiResolutionAnalysis<3> &mra, double prec);
+std::shared_ptr<mrcpp::HelmholtzOperator> helmholtz(const mrcpp::MultiResolutionAnalysis<3> &mra, double mu, double prec);
+Convolution_p convolution(const std::string &type,
+                          const mrcpp::MultiResolutionAnalysis<3> &mra,
+                          const std::vector<double> &params,
+                          double prec,
+                          const std::function<Convolution_p()> &build);
+Derivative_p derivative(const mrcpp::MultiResolutionAnalysis<3> &mra, const std::string &name);
+
+void clear();
+
+} // namespace operator_registry
+} // namespace mrchem
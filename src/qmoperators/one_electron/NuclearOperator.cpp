@@ -65,9 +65,15 @@ NuclearOperator::NuclearOperator(const Nuclei &nucs, double proj_prec, double sm
     double tot_prec = proj_prec / std::min(1.0 * Z_tot, std::sqrt(2.0 * Z_tot));
     double loc_prec = proj_prec / std::max(1.0, Z_loc);
 
+    // Local expansion of the far field pays off above a few hundred nuclei
+    if (f_loc.getNuclei().size() > 500) f_loc.setFarFieldPrecision(proj_prec / 10.0);
+
     // Project local potential
     QMFunction V_loc(false);
-    qmfunction::project(V_loc, f_loc, NUMBER::Real, loc_prec);
+    auto f_batch = [&f_loc](int n, const double *x, const double *y, const double *z, double *out) {
+        f_loc.evalBatch(n, x, y, z, out);
+    };
+    qmfunction::project(V_loc, f_loc, f_batch, NUMBER::Real, loc_prec);
     t_loc.stop();
 
     // Collect local potentials
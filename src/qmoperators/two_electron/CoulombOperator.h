@@ -77,6 +77,8 @@ public:
 
     auto &getPoisson() { return this->potential->getPoisson(); }
     auto &getDensity() { return this->potential->getDensity(); }
+    void setRebuildInterval(int n) { this->potential->setRebuildInterval(n); }
+    int getNUpdates() const { return this->potential->n_updates; }
 
 private:
     std::shared_ptr<CoulombPotential> potential{nullptr};
@@ -31,6 +31,8 @@
 #include "qmfunctions/Orbital.h"
 #include "qmfunctions/density_utils.h"
 #include "qmfunctions/orbital_utils.h"
+#include "qmfunctions/qmfunction_utils.h"
+#include "utils/ScopedTimer.h"
 #include "utils/print_utils.h"
 
 using mrcpp::Printer;
@@ -65,13 +67,15 @@ CoulombPotential::CoulombPotential(PoissonOperator_p P, OrbitalVector_p Phi, boo
  *
  * This will compute the Coulomb potential by application of the Poisson
  * operator to the density. If the density is not available it is computed
- * from the current orbitals (assuming that the orbitals are available).
+ * from the current orbitals (assuming that the orbitals are available), and
+ * the potential is updated incrementally if a valid reference exists.
  * For first-order perturbations the first order density and the Hessian will be
  * computed. In order to make the Hessian available to CoulombOperator, it is stored in the
  * potential function instead of the zeroth-order potential.
  *
  */
 void CoulombPotential::setup(double prec) {
+    ScopedTimer section("coulomb_setup");
     if (isSetup(prec)) return;
     setApplyPrec(prec);
     if (hasDensity()) {
@@ -83,15 +87,18 @@ void CoulombPotential::setup(double prec) {
         // Keep each local contribution a bit
         // more precise than strictly necessary
         setupLocalDensity(0.1 * prec);
-        QMFunction V = setupLocalPotential(0.1 * prec);
+        bool update = canUpdatePotential(prec);
+        QMFunction V = (update) ? updateLocalPotential(0.1 * prec) : setupLocalPotential(0.1 * prec);
         allreducePotential(0.1 * prec, V);
+        saveReference(prec, not update);
     }
 }
 
 /** @brief clear operator after application
  *
  * This will clear the operator and bring it back to the state after construction.
- * The operator can now be reused after another setup.
+ * The operator can now be reused after another setup. The reference for the
+ * incremental update is kept until the next setup.
  */
 void CoulombPotential::clear() {
     QMFunction::free(NUMBER::Total);   // delete FunctionTree pointers
@@ -153,6 +160,39 @@ QMFunction CoulombPotential::setupLocalPotential(double prec) {
     return V;
 }
 
+/** @brief compute Coulomb potential from the change in the local density
+ *
+ * @param prec: apply precision
+ *
+ * The Poisson operator is applied to rho - rho_ref with the same absolute precision
+ * as the full local potential would get, which means a much looser relative precision
+ * when the density change is small. The reference potential is added on the first
+ * orbital rank only, such that the allreduce gives V_ref + P[rho - rho_ref].
+ */
+QMFunction CoulombPotential::updateLocalPotential(double prec) {
+    if (this->poisson == nullptr) MSG_ERROR("Poisson operator not initialized");
+
+    PoissonOperator &P = *this->poisson;
+    OrbitalVector &Phi = *this->orbitals;
+    QMFunction &rho = this->density;
+
+    // Same absolute precision as in setupLocalPotential
+    double abs_prec = prec * rho.norm() / orbital::get_electron_number(Phi);
+
+    Timer timer;
+    QMFunction drho(false);
+    qmfunction::add(drho, 1.0, rho, -1.0, this->ref_density, -1.0);
+
+    QMFunction V(false);
+    V.alloc(NUMBER::Real);
+    mrcpp::apply(abs_prec, V.real(), P, drho.real(), -1, true);
+    if (mpi::orb_rank == 0) V.add(1.0, this->ref_potential);
+    println(3, " Coulomb density change    " << drho.norm());
+    print_utils::qmfunction(2, "Coulomb update", V, timer);
+
+    return V;
+}
+
 void CoulombPotential::allreducePotential(double prec, QMFunction &V_loc) {
     Timer t_com;
 
@@ -186,4 +226,47 @@ void CoulombPotential::allreducePotential(double prec, QMFunction &V_loc) {
     print_utils::qmfunction(2, "Allreduce Coulomb", V_tot, t_com);
 }
 
+/** @brief Check if the potential can be updated incrementally
+ *
+ * @param prec: reqested precision
+ *
+ * The reference can be used if it was rebuilt at the same or a tighter precision,
+ * and if less than rebuild_interval setups have passed since the last full rebuild.
+ */
+bool CoulombPotential::canUpdatePotential(double prec) const {
+    if (this->rebuild_interval < 2) return false;
+    if (not this->ref_density.hasReal()) return false;
+    if (prec < this->ref_prec) return false;
+    return (this->n_updates + 1 < this->rebuild_interval);
+}
+
+/** @brief Keep the current density and potential as reference for the next setup
+ *
+ * @param prec: precision used in the setup
+ * @param rebuilt: whether the potential was computed from scratch
+ *
+ * The functions are deep copied, since they are deleted in clear().
+ */
+void CoulombPotential::saveReference(double prec, bool rebuilt) {
+    if (this->rebuild_interval < 2) return;
+    if (rebuilt) {
+        this->n_updates = 0;
+        this->ref_prec = prec;
+    } else {
+        this->n_updates++;
+    }
+    this->ref_density = QMFunction(false);
+    qmfunction::deep_copy(this->ref_density, this->density);
+    this->ref_potential = QMFunction(false);
+    if (mpi::orb_rank == 0) qmfunction::deep_copy(this->ref_potential, *this);
+}
+
+/** @brief Remove the reference, next setup will be a full rebuild */
+void CoulombPotential::clearReference() {
+    this->n_updates = 0;
+    this->ref_prec = -1.0;
+    this->ref_density = QMFunction(false);
+    this->ref_potential = QMFunction(false);
+}
+
 } // namespace mrchem
@@ -45,6 +45,12 @@
  * on-the-fly in setup() ONLY if it is not already available. After setup() the
  * operator will be fixed until clear(), which deletes both the density and the
  * potential.
+ *
+ * Optionally, the density and potential are kept as reference between the setups
+ * from orbitals, and the next potential is computed from the density difference,
+ * V = V_ref + P[rho - rho_ref], where the Poisson operator is applied with the
+ * absolute precision of the full potential. The potential is rebuilt from scratch
+ * at regular intervals to limit the accumulation of errors.
  */
 
 namespace mrchem {
@@ -64,10 +70,17 @@ protected:
     std::shared_ptr<OrbitalVector> orbitals; ///< Unperturbed orbitals defining the ground-state electron density
     std::shared_ptr<mrcpp::PoissonOperator> poisson; ///< Operator used to compute the potential
 
+    int rebuild_interval{0};         ///< Number of setups between each full rebuild of the potential
+    int n_updates{0};                ///< Number of incremental updates since the last full rebuild
+    double ref_prec{-1.0};           ///< Precision of the last full rebuild
+    QMFunction ref_density{false};   ///< Local density defining the reference potential
+    QMFunction ref_potential{false}; ///< Total reference potential, kept on the first orbital rank
+
     auto &getPoisson() { return this->poisson; }
     auto &getDensity() { return this->density; }
 
     bool hasDensity() const { return (this->density.squaredNorm() < 0.0) ? false : true; }
+    void setRebuildInterval(int n) { this->rebuild_interval = n; }
 
     void setup(double prec) override;
     void clear() override;
@@ -77,7 +90,12 @@ protected:
 
     void setupGlobalPotential(double prec);
     QMFunction setupLocalPotential(double prec);
+    QMFunction updateLocalPotential(double prec);
     void allreducePotential(double prec, QMFunction &V_loc);
+
+    bool canUpdatePotential(double prec) const;
+    void saveReference(double prec, bool rebuilt);
+    void clearReference();
 };
 
 } // namespace mrchem
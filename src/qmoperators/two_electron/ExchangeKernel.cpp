@@ -0,0 +1,127 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+
+#include <algorithm>
+#include <cmath>
+
+#include <MRCPP/MWFunctions>
+#include <MRCPP/Printer>
+
+#include "ExchangeKernel.h"
+#include "mrchem.h"
+#include "qmoperators/OperatorRegistry.h"
+
+namespace mrchem {
+
+namespace {
+/** @brief Separated Gaussian expansion of (w_lr*erf(mu*r) + w_sr*erfc(mu*r))/r
+ *
+ * The quadrature is the trapezoidal rule in s = log(t) with the same step size
+ * as the MRCPP Poisson kernel, truncated where the remaining contributions are
+ * below prec within the range of distances [r_min, r_max] resolved by the MRA.
+ * The t-integral is split exactly at t = mu, such that the short- and long-range
+ * parts add up to the bare Coulomb kernel.
+ */
+exchange_kernel::Kernel_p build_cam_kernel(const mrcpp::MultiResolutionAnalysis<3> &mra,
+                                           double mu,
+                                           double w_lr,
+                                           double w_sr,
+                                           double prec) {
+    if (w_lr < 0.0 or w_sr < 0.0) MSG_ABORT("Negative weight in attenuated exchange kernel");
+    double r_min = mra.calcMinDistance(prec);
+    double r_max = mra.calcMaxDistance();
+    double t_min = prec * MATHCONST::sqrt_pi / (2.0 * r_max);
+    double t_max = std::sqrt(-std::log(prec)) / r_min;
+    double h = 1.0 / (0.2 - 0.47 * std::log10(prec));
+
+    mrcpp::GaussExp<1> kernel;
+    auto add_range = [&kernel, h](double w, double t_lo, double t_hi) {
+        if (w < mrcpp::MachineZero or t_hi <= t_lo) return;
+        double s_lo = std::log(t_lo);
+        double s_hi = std::log(t_hi);
+        int n_terms = std::max(1, static_cast<int>(std::ceil((s_hi - s_lo) / h)));
+        double ds = (s_hi - s_lo) / n_terms;
+        for (int i = 0; i <= n_terms; i++) {
+            double t = std::exp(s_lo + i * ds);
+            double w_i = (i == 0 or i == n_terms) ? 0.5 * ds : ds;
+            // 3D coefficient, the operator distributes it over the three directions
+            double coef = w * w_i * t * 2.0 / MATHCONST::sqrt_pi;
+            kernel.append(mrcpp::GaussFunc<1>(t * t, coef));
+        }
+    };
+    add_range(w_lr, t_min, std::min(mu, t_max));
+    add_range(w_sr, std::max(mu, t_min), t_max);
+    if (kernel.size() == 0) MSG_ABORT("Empty exchange kernel");
+
+    return std::make_shared<mrcpp::ConvolutionOperator<3>>(mra, kernel, prec);
+}
+} // namespace
+
+/** @brief Bare Coulomb kernel 1/r (the standard Poisson operator) */
+exchange_kernel::Kernel_p exchange_kernel::coulomb(const mrcpp::MultiResolutionAnalysis<3> &mra, double prec) {
+    return operator_registry::poisson(mra, prec);
+}
+
+/** @brief Short-range kernel erfc(mu*r)/r */
+exchange_kernel::Kernel_p exchange_kernel::short_range(const mrcpp::MultiResolutionAnalysis<3> &mra,
+                                                       double mu,
+                                                       double prec) {
+    return exchange_kernel::range_separated(mra, mu, 1.0, -1.0, prec);
+}
+
+/** @brief Long-range kernel erf(mu*r)/r */
+exchange_kernel::Kernel_p exchange_kernel::long_range(const mrcpp::MultiResolutionAnalysis<3> &mra,
+                                                      double mu,
+                                                      double prec) {
+    return exchange_kernel::range_separated(mra, mu, 0.0, 1.0, prec);
+}
+
+/** @brief CAM kernel (alpha + beta*erf(mu*r))/r
+ *
+ * This covers the exact exchange of all range-separated hybrids in the CAM
+ * parametrization, e.g. CAM-B3LYP (alpha = 0.19, beta = 0.46), LC functionals
+ * (alpha = 0, beta = 1) and screened hybrids like HSE (alpha = -beta = 0.25).
+ * Both alpha and alpha + beta must be non-negative.
+ */
+exchange_kernel::Kernel_p exchange_kernel::range_separated(const mrcpp::MultiResolutionAnalysis<3> &mra,
+                                                           double mu,
+                                                           double alpha,
+                                                           double beta,
+                                                           double prec) {
+    if (mu <= 0.0) MSG_ABORT("Invalid range-separation parameter");
+    auto build = [&mra, mu, alpha, beta, prec]() { return build_cam_kernel(mra, mu, alpha + beta, alpha, prec); };
+    return operator_registry::convolution("cam", mra, {mu, alpha, beta}, prec, build);
+}
+
+/** @brief Yukawa-screened kernel exp(-kappa*r)/r (a bound-state Helmholtz operator) */
+exchange_kernel::Kernel_p exchange_kernel::yukawa(const mrcpp::MultiResolutionAnalysis<3> &mra,
+                                                  double kappa,
+                                                  double prec) {
+    if (kappa <= 0.0) MSG_ABORT("Invalid screening parameter");
+    return operator_registry::helmholtz(mra, kappa, prec);
+}
+
+} // namespace mrchem
@@ -0,0 +1,62 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+
+#pragma once
+
+#include <memory>
+
+#include <MRCPP/MWOperators>
+
+/** @file ExchangeKernel.h
+ *
+ * @brief Interaction kernels for the exact exchange operator
+ *
+ * Besides the bare Coulomb kernel 1/r, the exchange can be computed with an
+ * attenuated interaction: short-range erfc(mu*r)/r, long-range erf(mu*r)/r, the
+ * CAM combination (alpha + beta*erf(mu*r))/r used by range-separated hybrids,
+ * or the Yukawa-screened exp(-kappa*r)/r. All kernels use the normalization of
+ * the mrcpp::PoissonOperator, i.e. they can be used in place of it.
+ *
+ * The attenuated kernels are built as separated Gaussian expansions of
+ * 1/r = 2/sqrt(pi) int_0^inf exp(-t^2 r^2) dt, where the error function
+ * simply splits the t-integral at t = mu. The operators are taken from the
+ * operator registry, so that repeated Fock operator setups (ground state and
+ * response) share the same operator, also with the Coulomb operator.
+ */
+
+namespace mrchem {
+namespace exchange_kernel {
+
+using Kernel_p = std::shared_ptr<mrcpp::ConvolutionOperator<3>>;
+
+Kernel_p coulomb(const mrcpp::MultiResolutionAnalysis<3> &mra, double prec);
+Kernel_p short_range(const mrcpp::MultiResolutionAnalysis<3> &mra, double mu, double prec);
+Kernel_p long_range(const mrcpp::MultiResolutionAnalysis<3> &mra, double mu, double prec);
+Kernel_p range_separated(const mrcpp::MultiResolutionAnalysis<3> &mra, double mu, double alpha, double beta, double prec);
+Kernel_p yukawa(const mrcpp::MultiResolutionAnalysis<3> &mra, double kappa, double prec);
+
+} // namespace exchange_kernel
+} // namespace mrchem
@@ -29,6 +29,7 @@
 
 #include "ExchangePotentialD1.h"
 #include "ExchangePotentialD2.h"
+#include "qmfunctions/orbital_utils.h"
 
 /**
  * @class ExchangeOperator
@@ -46,10 +47,11 @@ namespace mrchem {
 
 class ExchangeOperator final : public RankZeroOperator {
 public:
-    ExchangeOperator(std::shared_ptr<mrcpp::PoissonOperator> P,
+    ExchangeOperator(std::shared_ptr<mrcpp::ConvolutionOperator<3>> P,
                      std::shared_ptr<OrbitalVector> Phi,
-                     double exchange_prec = -1.0) {
-        exchange = std::make_shared<ExchangePotentialD1>(P, Phi, exchange_prec);
+                     double exchange_prec = -1.0,
+                     bool mpi_share = false) {
+        exchange = std::make_shared<ExchangePotentialD1>(P, Phi, exchange_prec, mpi_share);
 
         // Invoke operator= to assign *this operator
         RankZeroOperator &K = (*this);
@@ -57,7 +59,7 @@ public:
         K.name() = "K";
     }
 
-    ExchangeOperator(std::shared_ptr<mrcpp::PoissonOperator> P,
+    ExchangeOperator(std::shared_ptr<mrcpp::ConvolutionOperator<3>> P,
                      std::shared_ptr<OrbitalVector> Phi,
                      std::shared_ptr<OrbitalVector> X,
                      std::shared_ptr<OrbitalVector> Y,
@@ -74,9 +76,21 @@ public:
 
     auto &getPoisson() { return exchange->getPoisson(); }
     void setPreCompute() { exchange->setPreCompute(); }
+    void setACE() { exchange->setACE(); }
+    void setRebuildInterval(int n) { exchange->setRebuildInterval(n); }
     void rotate(const ComplexMatrix &U) { exchange->rotate(U); }
+    bool sharePairs(const ExchangeOperator &K) { return exchange->sharePairs(*K.exchange); }
+    nlohmann::json getPairScreening() const { return exchange->getPairScreening(); }
+
+    bool useInternalMatrix(const OrbitalVector &Phi) const { return exchange->useInternalMatrix(Phi); }
+    ComplexMatrix getInternalMatrix() { return exchange->getInternalMatrix(); }
 
-    ComplexDouble trace(OrbitalVector &Phi) { return 0.5 * RankZeroOperator::trace(Phi); }
+    ComplexDouble trace(OrbitalVector &Phi) {
+        if (not useInternalMatrix(Phi)) return 0.5 * RankZeroOperator::trace(Phi);
+        // on-the-fly exchange: reuse the matrix from the pair potentials
+        ComplexVector eta = orbital::get_occupations(Phi).cast<ComplexDouble>();
+        return 0.5 * eta.dot(getInternalMatrix().diagonal());
+    }
 
 private:
     std::shared_ptr<ExchangePotential> exchange{nullptr};
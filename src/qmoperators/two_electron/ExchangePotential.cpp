@@ -23,6 +23,10 @@
  * <https://mrchem.readthedocs.io/>
  */
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+
 #include "MRCPP/MWOperators"
 #include "MRCPP/Printer"
 #include "MRCPP/Timer"
@@ -33,36 +37,83 @@
 #include "qmfunctions/OrbitalIterator.h"
 #include "qmfunctions/orbital_utils.h"
 #include "qmfunctions/qmfunction_utils.h"
+#include "utils/ScopedTimer.h"
+#include "utils/memory_utils.h"
 #include "utils/print_utils.h"
 
 using mrcpp::Printer;
 using mrcpp::Timer;
 
-using PoissonOperator = mrcpp::PoissonOperator;
-using PoissonOperator_p = std::shared_ptr<mrcpp::PoissonOperator>;
+using ConvolutionOperator_p = std::shared_ptr<mrcpp::ConvolutionOperator<3>>;
 using OrbitalVector_p = std::shared_ptr<mrchem::OrbitalVector>;
 
 namespace mrchem {
 
+namespace {
+const double default_pair_limit = 2000.0; ///< Memory (MB) per rank of the stored pair potentials without budget
+
+/** Append a cell norm table to a flat vector, for communication */
+void pack_cell_norms(const qmfunction::CellNormTable &table, std::vector<double> &out) {
+    out.push_back(table.size());
+    for (const auto &cells : table) {
+        out.push_back(cells.size());
+        for (const auto &cell : cells) {
+            for (int d = 0; d < 4; d++) out.push_back(cell.first[d]);
+            out.push_back(cell.second.leaf ? 1.0 : 0.0);
+            out.push_back(cell.second.norm2);
+            out.push_back(cell.second.sup);
+        }
+    }
+}
+
+/** Read a cell norm table from a flat vector, inverse of pack_cell_norms */
+qmfunction::CellNormTable unpack_cell_norms(const double *data) {
+    qmfunction::CellNormTable table(std::lround(*data++));
+    for (auto &cells : table) {
+        auto n_cells = std::lround(*data++);
+        for (long c = 0; c < n_cells; c++, data += 7) {
+            std::array<int, 4> key;
+            for (int d = 0; d < 4; d++) key[d] = static_cast<int>(std::lround(data[d]));
+            auto &cell = cells[key];
+            cell.leaf = (data[4] > 0.5);
+            cell.norm2 = data[5];
+            cell.sup = data[6];
+        }
+    }
+    return table;
+}
+} // namespace
+
 /** @brief constructor
  *
- * @param[in] P Poisson operator (does not take ownership)
+ * @param[in] P interaction kernel, Poisson or attenuated (does not take ownership)
  * @param[in] Phi vector of orbitals which define the exchange operator
  * @param[in] prec screening precision for exchange construction
  */
-ExchangePotential::ExchangePotential(PoissonOperator_p P, OrbitalVector_p Phi, double prec)
+ExchangePotential::ExchangePotential(ConvolutionOperator_p P, OrbitalVector_p Phi, double prec)
         : exchange_prec(prec)
         , orbitals(Phi)
-        , poisson(P) {}
+        , poisson(P)
+        , pairs(std::make_shared<ExchangePairs>()) {}
 
 /** @brief Perform a unitary transformation among the precomputed exchange contributions
  *
  * @param[in] U unitary matrix defining the rotation
  */
 void ExchangePotential::rotate(const ComplexMatrix &U) {
-    if (this->exchange.size() == 0) return;
+    this->internal_matrix = ComplexMatrix();
+    if (this->exchange.size() == 0) {
+        clearReference();
+        return;
+    }
     this->exchange = orbital::rotate(this->exchange, U, this->apply_prec);
 
+    // the reference for the incremental update is kept unrotated, so the
+    // rotation enters the next update as a change of the orbitals, which
+    // is only worthwhile if the rotation is close to the identity
+    int N = U.rows();
+    if ((U - ComplexMatrix::Identity(N, N)).cwiseAbs().maxCoeff() > 0.1) clearReference();
+
     // NOTE: The following MPI point is currently NOT implemented!
     //
     // the last parameter, 1, means MPI will send only one orbital at a time
@@ -114,22 +165,266 @@ double ExchangePotential::getSpinFactor(Orbital phi_i, Orbital phi_j) const {
  * @param[in] prec reqested precision
  *
  * This will save the defining orbitals in the orbital bank
- * and optionally compute the internal constributions.
+ * and optionally compute the internal constributions. The precomputed
+ * contributions are skipped if they are not expected to fit within the
+ * memory budget, in which case the exchange is computed on-the-fly.
  */
 void ExchangePotential::setup(double prec) {
+    ScopedTimer section("exchange_setup");
     if (mpi::world_size > 1 and mpi::bank_size < 1) MSG_ABORT("MPI bank required!");
     setApplyPrec(prec);
+    this->internal_matrix = ComplexMatrix();
     setupBank();
-    if (this->pre_compute) setupInternal(prec);
+    setupCellNorms();
+    if (this->pre_compute) {
+        // K|phi_i> plus the temporary contributions are roughly twice the size of the orbitals
+        double mem_estimate = 2.0 * orbital::get_size_nodes(*this->orbitals) / 1024.0;
+        if (memory_utils::fits(mem_estimate, mpi::comm_orb)) {
+            setupInternal(prec);
+        } else {
+            println(1, " Memory budget exceeded: using on-the-fly exchange");
+            clearReference();
+        }
+    }
+}
+
+/** @brief Compute the screening norms of the internal orbitals
+ *
+ * The coarse cell norms used to bound the pair products are computed once per
+ * setup by the owner of each orbital and shared among the ranks, so that the
+ * pair screening does not need to revisit the orbital trees.
+ */
+void ExchangePotential::setupCellNorms() {
+    OrbitalVector &Phi = *this->orbitals;
+    int N = Phi.size();
+    this->cell_norms = std::vector<qmfunction::CellNormTable>(N);
+    for (int i = 0; i < N; i++) {
+        if (mpi::my_orb(Phi[i])) this->cell_norms[i] = qmfunction::calc_cell_norms(Phi[i]);
+    }
+    if (mpi::orb_size < 2) return;
+
+    // each table is written by its owner into its own segment of a common vector
+    IntVector sizes = IntVector::Zero(N);
+    std::vector<std::vector<double>> packed(N);
+    for (int i = 0; i < N; i++) {
+        if (not mpi::my_orb(Phi[i])) continue;
+        pack_cell_norms(this->cell_norms[i], packed[i]);
+        sizes(i) = packed[i].size();
+    }
+    mpi::allreduce_vector(sizes, mpi::comm_orb);
+    std::vector<int> offsets(N + 1, 0);
+    for (int i = 0; i < N; i++) offsets[i + 1] = offsets[i] + sizes(i);
+    DoubleVector data = DoubleVector::Zero(offsets[N]);
+    for (int i = 0; i < N; i++) {
+        for (int k = 0; k < packed[i].size(); k++) data(offsets[i] + k) = packed[i][k];
+    }
+    mpi::allreduce_vector(data, mpi::comm_orb);
+    for (int i = 0; i < N; i++) {
+        if (not mpi::my_orb(Phi[i])) this->cell_norms[i] = unpack_cell_norms(data.data() + offsets[i]);
+    }
+}
+
+/** @brief Test if the product of two internal orbitals is below the precision
+ *
+ * Uses the upper bound of ||phi_i^dagger * phi_j|| from the cell norms of the
+ * current setup. Without the cell norms no pairs are considered negligible.
+ */
+bool ExchangePotential::isNegligiblePair(int i, int j, double prec) const {
+    if (this->cell_norms.size() != this->orbitals->size()) return false;
+    return (qmfunction::calc_product_bound(this->cell_norms[i], this->cell_norms[j]) < prec);
+}
+
+/** @brief Build the list of orbital pairs that contribute to the internal exchange
+ *
+ * @param[in] prec precision of the individual pair contributions
+ *
+ * Pairs are dropped if the upper bound of the pair density ||phi_i^dag * phi_j||
+ * from the cell norms of the current setup is below the precision, and the sum of
+ * the dropped bounds is reported. With delocalized (canonical) orbitals the bounds
+ * are large and no pairs are dropped. The orbitals are also sorted along the
+ * direction of largest extent of their centroids, so that neighboring orbitals
+ * end up in the same blocks.
+ */
+void ExchangePotential::setupNeighbors(double prec) {
+    OrbitalVector &Phi = *this->orbitals;
+    int N = Phi.size();
+    DoubleMatrix R = orbital::calc_centroids(Phi);
+
+    this->neighbors = IntMatrix::Ones(N, N);
+    this->n_screened = 0;
+    this->screened_bound = 0.0;
+    if (prec > 0.0 and this->cell_norms.size() == N) {
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < i; j++) {
+                double bound = qmfunction::calc_product_bound(this->cell_norms[i], this->cell_norms[j]);
+                if (bound >= prec) continue;
+                this->neighbors(i, j) = 0;
+                this->neighbors(j, i) = 0;
+                this->n_screened += 2;
+                this->screened_bound += 2.0 * bound;
+            }
+        }
+    }
+
+    int axis = 0;
+    if (N > 0) (R.leftCols(3).colwise().maxCoeff() - R.leftCols(3).colwise().minCoeff()).maxCoeff(&axis);
+    this->spatial_order.resize(N);
+    for (int i = 0; i < N; i++) this->spatial_order[i] = i;
+    std::stable_sort(this->spatial_order.begin(), this->spatial_order.end(), [&R, axis](int i, int j) {
+        return R(i, axis) < R(j, axis);
+    });
+
+    if (this->n_screened > 0) {
+        println(2, " Exchange pairs screened   " << this->n_screened << " of " << N * N << " (bound " << this->screened_bound << ")");
+    }
+}
+
+/** @brief Summary of the pair screening in the last setup */
+nlohmann::json ExchangePotential::getPairScreening() const {
+    int N = this->orbitals->size();
+    return {{"pairs_total", N * N}, {"pairs_screened", this->n_screened}, {"screened_bound", this->screened_bound}};
+}
+
+/** @brief Check if the internal exchange can be updated incrementally
+ *
+ * @param[in] prec reqested precision
+ *
+ * The reference exchange can be updated if it is defined by the same number of
+ * orbitals, if it was rebuilt at the same or a tighter precision, and if less
+ * than rebuild_interval setups have passed since the last full rebuild.
+ */
+bool ExchangePotential::canUpdateInternal(double prec) const {
+    if (this->rebuild_interval < 2) return false;
+    if (this->ref_exchange.size() != this->orbitals->size()) return false;
+    if (prec < this->ref_prec) return false;
+    return (this->n_updates + 1 < this->rebuild_interval);
+}
+
+/** @brief Keep the current internal exchange as reference for the next setup
+ *
+ * @param[in] prec precision used in the setup
+ * @param[in] rebuilt whether the exchange was computed from scratch
+ *
+ * The orbitals are deep copied, since they are updated in place between the setups.
+ */
+void ExchangePotential::saveReference(double prec, bool rebuilt) {
+    if (this->rebuild_interval < 2) return;
+    if (rebuilt) {
+        this->n_updates = 0;
+        this->ref_prec = prec;
+    } else {
+        this->n_updates++;
+    }
+    this->ref_orbitals = orbital::deep_copy(*this->orbitals);
+    this->ref_exchange = this->exchange;
+}
+
+/** @brief Remove the reference exchange, next setup will be a full rebuild */
+void ExchangePotential::clearReference() {
+    this->n_updates = 0;
+    this->ref_prec = -1.0;
+    this->ref_orbitals.clear();
+    this->ref_exchange.clear();
+    clearPairs();
+}
+
+/** @brief Use the pair potentials of another operator
+ *
+ * @param[in] other operator to share the pair potentials with
+ *
+ * Only possible if both operators are defined by the same orbitals and the
+ * same kernel. Returns false, and keeps the own pair potentials, otherwise.
+ */
+bool ExchangePotential::sharePairs(const ExchangePotential &other) {
+    if (other.orbitals != this->orbitals or other.poisson != this->poisson) return false;
+    this->pairs = other.pairs;
+    return true;
+}
+
+/** @brief Test if the N(N+1)/2 pair potentials can be stored
+ *
+ * @param[in] orb_kb total size (kB) of the internal orbitals
+ *
+ * Each pair potential is roughly of orbital size, and they are distributed
+ * among the bank ranks, or among the orbital ranks without bank. They must
+ * fit within the memory budget, or below a default limit per rank if no
+ * budget is given, otherwise the caller falls back to a full rebuild.
+ */
+bool ExchangePotential::canStorePairs(double orb_kb) const {
+    int N = this->orbitals->size();
+    int n_hold = (bank_size > 0) ? mpi::bank_size : mpi::orb_size;
+    double mem_estimate = 0.5 * (N + 1) * orb_kb / (1024.0 * n_hold);
+    if (memory_utils::has_budget()) return memory_utils::fits(mem_estimate, mpi::comm_orb);
+    return (mem_estimate <= default_pair_limit);
+}
+
+/** @brief Remove the stored pair potentials */
+void ExchangePotential::clearPairs() {
+    this->pairs->prec = -1.0;
+    this->pairs->norms = DoubleVector();
+    this->pairs->potentials.clear();
+    if (bank_size > 0) this->pairs->bank.clear();
+}
+
+/** @brief Returns the stored pair potential P[phi_i^dag * phi_j]
+ *
+ * @param[in] remove take the potential out of the storage, to be replaced
+ *
+ * Only i <= j is stored, the others are given as P[phi_j^dag * phi_i]^dag.
+ * Pair potentials fetched from the bank must be freed by the caller.
+ */
+Orbital ExchangePotential::getPairPotential(int i, int j, bool remove) {
+    int N = this->orbitals->size();
+    int ij = std::min(i, j) + std::max(i, j) * N;
+    Orbital V_ij;
+    if (bank_size > 0) {
+        if (remove) {
+            this->pairs->bank.get_orb_del(ij, V_ij);
+        } else {
+            this->pairs->bank.get_orb(ij, V_ij, 1);
+        }
+    } else {
+        V_ij = this->pairs->potentials[ij];
+        if (remove) this->pairs->potentials[ij] = Orbital();
+    }
+    return (i <= j) ? V_ij : V_ij.dagger();
+}
+
+/** @brief Store the pair potential V_ij = P[phi_i^dag * phi_j]
+ *
+ * Potentials with i > j are stored as V_ji = V_ij^dag. The norms are not
+ * updated here, since the pairs are distributed among the ranks, and must
+ * be collected by the caller. Potentials stored in the bank are freed locally.
+ */
+void ExchangePotential::putPairPotential(int i, int j, Orbital V_ij) {
+    int N = this->orbitals->size();
+    int ij = std::min(i, j) + std::max(i, j) * N;
+    Orbital V_out = V_ij;
+    if (i > j) {
+        V_out = V_ij.paramCopy();
+        ComplexVector coef = ComplexVector::Ones(1);
+        QMFunctionVector func_vec;
+        func_vec.push_back(V_ij.dagger());
+        qmfunction::linear_combination(V_out, coef, func_vec, -1.0);
+    }
+    if (bank_size > 0) {
+        this->pairs->bank.put_orb(ij, V_out);
+        V_out.free(NUMBER::Total);
+    } else {
+        this->pairs->potentials[ij] = V_out;
+    }
 }
 
 /** @brief Clears the Exchange Operator
  *
  *  Deletes the precomputed exchange contributions and
- *  clears the orbital bank.
+ *  clears the orbital bank. The reference for the incremental
+ *  update is kept until the next setup.
  */
 void ExchangePotential::clear() {
     clearInternal();
+    this->internal_matrix = ComplexMatrix();
+    this->cell_norms.clear();
     clearBank();
     clearApplyPrec();
 }
@@ -142,19 +437,26 @@ void ExchangePotential::clear() {
  *  \param[out] out_kij result
  *  \param[out] out_jji (optional), result where phi_k is replaced by phi_j (i.e. phi_k not used, and phi_j used
  * twice)
+ *  \param[out] out_ij (optional), the pair potential P[phi_i^dag * phi_j]
  *
  * Computes the product of complex conjugate of phi_i and phi_j,
  * then applies the Poisson operator, and multiplies the result
  * by phi_k (and optionally by phi_j). The result is given in phi_out.
+ *
+ * Pairs of internal orbitals should be screened by the caller before the product
+ * is computed (isNegligiblePair), using the cell norms of the current setup. The
+ * product itself is computed with max-norm guided refinement, so nodes are
+ * only refined where both orbitals are significant.
  */
 void ExchangePotential::calcExchange_kij(double prec,
                                          Orbital phi_k,
                                          Orbital phi_i,
                                          Orbital phi_j,
                                          Orbital &out_kij,
-                                         Orbital *out_jji) {
+                                         Orbital *out_jji,
+                                         Orbital *out_ij) {
     Timer timer_tot;
-    mrcpp::PoissonOperator &P = *this->poisson;
+    mrcpp::ConvolutionOperator<3> &P = *this->poisson;
 
     // set precisions
     double prec_m1 = prec / 10;  // first multiplication
@@ -221,6 +523,7 @@ void ExchangePotential::calcExchange_kij(double prec,
         norm_jji = out_jji->norm();
     }
     timer_jji.stop();
+    if (out_ij != nullptr) *out_ij = V_ij;
 
     println(4,
             " time " << (int)((float)timer_tot.elapsed() * 1000) << " ms "
@@ -27,14 +27,30 @@
 
 #include <memory>
 
+#include <nlohmann/json.hpp>
+
 #include "qmoperators/QMOperator.h"
 
 #include "qmfunctions/Orbital.h"
 #include "qmfunctions/qmfunction_fwd.h"
+#include "qmfunctions/qmfunction_utils.h"
 #include "utils/Bank.h"
 
 namespace mrchem {
 
+/** @brief Pair potentials P[phi_i^dag phi_j] (i <= j) of a set of orbitals
+ *
+ * Held through a shared pointer, such that operators defined by the same orbitals
+ * and the same kernel can share them, e.g. the unperturbed and perturbed exchange
+ * of all response calculations on the same ground state.
+ */
+struct ExchangePairs {
+    double prec{-1.0};        ///< Precision of the stored pair potentials
+    BankAccount bank;         ///< Stored pair potentials, if the bank is present
+    DoubleVector norms;       ///< Norms of the stored pair potentials, zero if not stored
+    OrbitalVector potentials; ///< Stored pair potentials, only used without bank
+};
+
 /** @class ExchangePotential
  *
  *  @brief Hartree-Fock exchange potential defined by a particular set of orbitals
@@ -47,23 +63,50 @@ namespace mrchem {
  * screening based on previous calculations of the internal exchange (make sure that
  * the internal orbitals haven't been significantly changed since the last time the
  * operator was set up, e.g. through an orbital rotation).
+ *
+ * Optionally, the precomputed exchange is kept as a reference between the setups,
+ * together with a copy of the orbitals and the pair potentials that defined it, such
+ * that the next setup only needs to account for the change in the orbitals. The reference is rebuilt
+ * from scratch at regular intervals to limit the accumulation of errors.
+ *
+ * When the exchange is computed on-the-fly, the matrix elements among the internal
+ * orbitals can be computed directly from the pair potentials, and are kept until the
+ * next setup, such that the Fock matrix and the energy share the same build.
  */
 
 class ExchangePotential : public QMOperator {
 public:
-    ExchangePotential(std::shared_ptr<mrcpp::PoissonOperator> P, std::shared_ptr<OrbitalVector> Phi, double prec);
+    ExchangePotential(std::shared_ptr<mrcpp::ConvolutionOperator<3>> P, std::shared_ptr<OrbitalVector> Phi, double prec);
     ~ExchangePotential() override = default;
 
     friend class ExchangeOperator;
 
 protected:
-    bool pre_compute{false};                         ///< Precompute internal exchange
-    double exchange_prec;                            ///< Screening precision for exchange construction
-    OrbitalVector exchange;                          ///< Precomputed exchange from the internal orbital set
-    std::shared_ptr<OrbitalVector> orbitals;         ///< Internal orbitals defining the exchange operator
-    std::shared_ptr<mrcpp::PoissonOperator> poisson; ///< Poisson operator to compute orbital contributions
+    bool pre_compute{false};                                ///< Precompute internal exchange
+    bool use_ace{false};                                    ///< Build the compressed exchange (ACE) in each setup
+    double exchange_prec;                                   ///< Screening precision for exchange construction
+    OrbitalVector exchange;                                 ///< Precomputed exchange from the internal orbital set
+    ComplexMatrix internal_matrix;                          ///< Exchange matrix among the internal orbitals
+    std::shared_ptr<OrbitalVector> orbitals;                ///< Internal orbitals defining the exchange operator
+    std::shared_ptr<mrcpp::ConvolutionOperator<3>> poisson; ///< Interaction kernel, Poisson or attenuated
+
+    int rebuild_interval{0};    ///< Number of setups between each full rebuild of the internal exchange
+    int n_updates{0};           ///< Number of incremental updates since the last full rebuild
+    double ref_prec{-1.0};      ///< Precision of the last full rebuild
+    OrbitalVector ref_orbitals; ///< Copy of the orbitals that define the reference exchange
+    OrbitalVector ref_exchange; ///< Reference exchange from the last setup
+
+    std::shared_ptr<ExchangePairs> pairs; ///< Pair potentials kept between setups
+
+    std::vector<qmfunction::CellNormTable> cell_norms; ///< Screening norms of the internal orbitals, per setup
+    IntMatrix neighbors;            ///< Orbital pairs that contribute to the internal exchange
+    std::vector<int> spatial_order; ///< Orbital indices sorted along the largest extent of the centroids
+    int n_screened{0};              ///< Number of pairs dropped from the neighbor list
+    double screened_bound{0.0};     ///< Upper bound to the sum of the dropped pair density norms
 
     void setPreCompute() { this->pre_compute = true; }
+    void setACE() { this->use_ace = true; }
+    void setRebuildInterval(int n) { this->rebuild_interval = n; }
 
     auto &getPoisson() { return this->poisson; }
     double getSpinFactor(Orbital phi_i, Orbital phi_j) const;
@@ -77,14 +120,34 @@ protected:
 
     virtual int testInternal(Orbital phi_p) const { return -1; }
     virtual void setupInternal(double prec) {}
-    void clearInternal() { this->exchange.clear(); }
+    virtual void clearInternal() { this->exchange.clear(); }
+
+    virtual bool useInternalMatrix(const OrbitalVector &Phi) const { return false; }
+    virtual ComplexMatrix getInternalMatrix() { NOT_IMPLEMENTED_ABORT; }
+
+    void setupCellNorms();
+    bool isNegligiblePair(int i, int j, double prec) const;
+    void setupNeighbors(double prec);
+    bool isNeighbor(int i, int j) const { return (this->neighbors.size() == 0 or this->neighbors(i, j) != 0); }
+    nlohmann::json getPairScreening() const;
+
+    bool canUpdateInternal(double prec) const;
+    void saveReference(double prec, bool rebuilt);
+    void clearReference();
+
+    bool sharePairs(const ExchangePotential &other);
+    bool canStorePairs(double orb_kb) const;
+    void clearPairs();
+    Orbital getPairPotential(int i, int j, bool remove = false);
+    void putPairPotential(int i, int j, Orbital V_ij);
 
     void calcExchange_kij(double prec,
                           Orbital phi_k,
                           Orbital phi_i,
                           Orbital phi_j,
                           Orbital &out_kij,
-                          Orbital *out_jji = nullptr);
+                          Orbital *out_jji = nullptr,
+                          Orbital *out_ij = nullptr);
 };
 
 } // namespace mrchem
@@ -23,6 +23,14 @@
  * <https://mrchem.readthedocs.io/>
  */
 
+#include <chrono>
+#include <list>
+#include <map>
+#include <set>
+#include <thread>
+
+#include <Eigen/Cholesky>
+
 #include "MRCPP/MWOperators"
 #include "MRCPP/Printer"
 #include "MRCPP/Timer"
@@ -33,26 +41,80 @@
 #include "qmfunctions/OrbitalIterator.h"
 #include "qmfunctions/orbital_utils.h"
 #include "qmfunctions/qmfunction_utils.h"
+#include "utils/memory_utils.h"
 #include "utils/print_utils.h"
 
 using mrcpp::Printer;
 using mrcpp::Timer;
 
-using PoissonOperator = mrcpp::PoissonOperator;
-using PoissonOperator_p = std::shared_ptr<mrcpp::PoissonOperator>;
+using ConvolutionOperator_p = std::shared_ptr<mrcpp::ConvolutionOperator<3>>;
 using OrbitalVector_p = std::shared_ptr<mrchem::OrbitalVector>;
 using QMOperator_p = std::shared_ptr<mrchem::QMOperator>;
 
 namespace mrchem {
 
+namespace {
+/** @brief Orbitals fetched from the bank, kept for reuse in later exchange tasks
+ *
+ * The least recently used orbitals are dropped when the cache is full. Orbitals
+ * still in use by the current task are kept alive by their own references.
+ */
+class OrbitalCache final {
+public:
+    OrbitalCache(BankAccount &b, int n, const OrbitalVector &r)
+            : bank(b)
+            , max_size(n)
+            , replicas(r) {}
+
+    Orbital get(int i) {
+        if (i < static_cast<int>(this->replicas.size())) {
+            this->hits++;
+            return this->replicas[i];
+        }
+        auto it = this->orbs.find(i);
+        if (it != this->orbs.end()) {
+            this->used.remove(i);
+            this->used.push_back(i);
+            this->hits++;
+            return it->second;
+        }
+        while (static_cast<int>(this->orbs.size()) >= this->max_size and not this->used.empty()) {
+            this->orbs.erase(this->used.front());
+            this->used.pop_front();
+        }
+        Orbital phi_i;
+        this->t_fetch.resume();
+        this->bank.get_orb(i, phi_i, 1);
+        this->t_fetch.stop();
+        this->orbs.insert({i, phi_i});
+        this->used.push_back(i);
+        this->misses++;
+        return phi_i;
+    }
+
+    int hits{0};
+    int misses{0};
+    Timer t_fetch{false}; ///< Time spent fetching orbitals from the bank
+
+private:
+    BankAccount &bank;
+    int max_size;
+    const OrbitalVector &replicas; ///< Node-shared copies of all orbitals, if available
+    std::list<int> used;
+    std::map<int, Orbital> orbs;
+};
+} // namespace
+
 /** @brief constructor
  *
- * @param[in] P Poisson operator (does not take ownership)
+ * @param[in] P interaction kernel, Poisson or attenuated (does not take ownership)
  * @param[in] Phi vector of orbitals which define the exchange operator
  * @param[in] prec screening precision for exchange construction
+ * @param[in] mpi_share fetch the orbitals once per node into MPI shared memory
  */
-ExchangePotentialD1::ExchangePotentialD1(PoissonOperator_p P, OrbitalVector_p Phi, double prec)
-        : ExchangePotential(P, Phi, prec) {}
+ExchangePotentialD1::ExchangePotentialD1(ConvolutionOperator_p P, OrbitalVector_p Phi, double prec, bool mpi_share)
+        : ExchangePotential(P, Phi, prec)
+        , share_orbitals(mpi_share) {}
 
 /** @brief Save all orbitals in Bank, so that they can be accessed asynchronously */
 void ExchangePotentialD1::setupBank() {
@@ -67,11 +129,79 @@ void ExchangePotentialD1::setupBank() {
     mrcpp::print::time(4, "Setting up exchange bank", timer);
 }
 
+/** @brief Test if the orbitals should be replicated in node-shared memory
+ *
+ *  @param[in] N number of orbitals
+ *  @param[in] orb_mb average orbital size (MB)
+ *
+ * The replicas hold all N orbitals on each node, which is shared among the local
+ * ranks. This is a collective operation when a memory budget is set.
+ */
+bool ExchangePotentialD1::useReplicas(int N, double orb_mb) const {
+    if (not this->share_orbitals or mpi::share_size < 2 or mpi::bank_size < 1) return false;
+    if (memory_utils::has_budget()) return memory_utils::fits(N * orb_mb / mpi::share_size, mpi::comm_orb);
+    return true;
+}
+
+/** @brief Fetch all orbitals from the bank once per node into MPI shared memory
+ *
+ * Only the share master of each node fetches the orbitals, and copies them into
+ * a single shared memory block sized after the orbitals, which are known by their
+ * owners. The other ranks of the node attach to the same block, so each orbital is
+ * transferred and stored once per node. The replicas are read-only, and the block is
+ * released with the last replica at the end of the setup. This is a collective
+ * operation within comm_orb.
+ */
+OrbitalVector ExchangePotentialD1::setupReplicas() {
+    Timer timer;
+    OrbitalVector &Phi = *this->orbitals;
+    int N = Phi.size();
+
+    IntVector sizes = IntVector::Zero(2 * N); // kB of the real and imaginary parts
+    for (int i = 0; i < N; i++) {
+        if (not mpi::my_orb(Phi[i])) continue;
+        if (Phi[i].hasReal()) sizes(i) = Phi[i].real().getSizeNodes();
+        if (Phi[i].hasImag()) sizes(N + i) = Phi[i].imag().getSizeNodes();
+    }
+    mpi::allreduce_vector(sizes, mpi::comm_orb);
+
+    // generous margin for the chunked node allocation of each tree, unused memory is only virtual
+    int n_trees = (sizes.array() > 0).count();
+    int sh_mb = 2 * static_cast<int>(sizes.cast<long long>().sum() / 1024) + 16 * n_trees + 16;
+    std::shared_ptr<mrcpp::SharedMemory> sh_mem;
+#ifdef MRCPP_HAS_MPI
+    sh_mem = std::make_shared<mrcpp::SharedMemory>(mpi::comm_share, sh_mb);
+#endif
+
+    // all ranks of the node allocate the trees in the same order within the block
+    OrbitalVector replicas;
+    for (int i = 0; i < N; i++) {
+        Orbital phi_i;
+        if (mpi::share_master()) PhiBank.get_orb(i, phi_i, 1);
+        Orbital rep_i = Phi[i].paramCopy();
+        rep_i = QMFunction(sh_mem);
+        if (sizes(i) > 0) rep_i.alloc(NUMBER::Real);
+        if (sizes(N + i) > 0) rep_i.alloc(NUMBER::Imag);
+        qmfunction::deep_copy(rep_i, phi_i);
+        replicas.push_back(rep_i);
+    }
+    println(4, " Shared memory block for exchange orbitals " << sh_mb << " MB");
+    mrcpp::print::time(4, "Sharing exchange orbitals", timer);
+    return replicas;
+}
+
 /** @brief Clears rbital bank accounts.
  *
  */
 void ExchangePotentialD1::clearBank() {
     PhiBank.clear();
+    if (this->use_ace) AceBank.clear();
+}
+
+/** @brief Clears the precomputed exchange and its compressed form */
+void ExchangePotentialD1::clearInternal() {
+    this->exchange.clear();
+    this->ace.clear();
 }
 
 /** @brief Test if a given contribution has been precomputed
@@ -102,7 +232,8 @@ int ExchangePotentialD1::testInternal(Orbital phi_p) const {
  *  @param[in] inp input orbital
  *
  * The exchange potential is applied to the given orbital. Checks first if this
- * particular exchange contribution has been precomputed.
+ * particular exchange contribution has been precomputed, otherwise the compressed
+ * exchange is used if it has been built.
  */
 Orbital ExchangePotentialD1::apply(Orbital phi_p) {
     Orbital out_p = phi_p.paramCopy();
@@ -116,6 +247,10 @@ Orbital ExchangePotentialD1::apply(Orbital phi_p) {
             MSG_WARN("Not computing exchange contributions that are not mine");
             return out_p;
         }
+        if (this->ace.size() > 0) {
+            println(4, "Compressed exchange");
+            return calcCompressedExchange(phi_p);
+        }
         println(4, "On-the-fly exchange");
         return calcExchange(phi_p);
     } else {
@@ -142,32 +277,135 @@ QMOperatorVector ExchangePotentialD1::apply(QMOperator_p &O) {
  *
  *  @param[in] phi_p input orbital
  *
- * The exchange potential is (pre)computed among the orbitals that define the operator
+ * The exchange potential is (pre)computed among the orbitals that define the operator.
+ * If a valid reference from the previous setup exists, it is updated incrementally,
+ * otherwise the exchange is rebuilt from scratch. With incremental updates enabled,
+ * the pair potentials are kept as part of the reference if they fit in memory.
+ * The compressed exchange, if requested, is rebuilt from the result in every setup.
  */
 void ExchangePotentialD1::setupInternal(double prec) {
-    Timer timerT, timerS(false), timerR(false), t_calc(false), t_add(false), t_get(false), t_wait(false);
+    OrbitalVector &Phi = *this->orbitals;
+    int N = Phi.size();
+    if (canUpdateInternal(prec) and this->pairs->norms.size() == N * N) {
+        updateInternal(prec);
+        if (this->use_ace) setupACE();
+        return;
+    }
+    Timer timerT;
     setApplyPrec(prec);
     if (this->exchange.size() != 0) MSG_ERROR("Exchange not properly cleared");
 
     OrbitalVector &Ex = this->exchange;
-    OrbitalVector &Phi = *this->orbitals;
-    BankAccount ExBank;
-    int N = Phi.size();
     // use fixed exchange_prec if set explicitly, otherwise use setup prec
     double precf = (this->exchange_prec > 0.0) ? this->exchange_prec : prec;
     prec = mpi::numerically_exact ? -1.0 : prec;
     precf /= std::sqrt(1 * Phi.size());
+    setupNeighbors(precf);
+
+    DoubleVector orb_kb = DoubleVector::Constant(1, orbital::get_size_nodes(Phi));
+    mpi::allreduce_vector(orb_kb, mpi::comm_orb);
+    double orb_mb = orb_kb(0) / (1024.0 * N);
+    int block_size = calcBlockSize(N, orb_mb);
+
+    // N(N+1)/2 pair potentials of roughly orbital size, distributed among the ranks
+    clearPairs();
+    bool store_pairs = false;
+    if (this->rebuild_interval > 1) {
+        store_pairs = canStorePairs(orb_kb(0));
+        if (not store_pairs) println(2, " Pair potentials exceed the memory limit: exchange is rebuilt in every setup");
+    }
+    if (store_pairs) {
+        this->pairs->prec = precf;
+        this->pairs->norms = DoubleVector::Zero(N * N);
+        if (bank_size < 1) this->pairs->potentials = OrbitalVector(N * N);
+    }
+    auto store_pair = [this, N](int i, int j, Orbital &V_ij) {
+        if (not(V_ij.hasReal() or V_ij.hasImag())) return;
+        this->pairs->norms(std::min(i, j) + std::max(i, j) * N) = V_ij.norm();
+        putPairPotential(i, j, V_ij);
+    };
+
     // Initialize this->exchange and compute own diagonal elements
     Timer timerD;
-    for (auto &phi_i : Phi) {
+    for (int i = 0; i < N; i++) {
+        Orbital &phi_i = Phi[i];
         Orbital ex_iii = phi_i.paramCopy();
-        t_calc.resume();
-        if (mpi::my_orb(phi_i)) calcExchange_kij(precf, phi_i, phi_i, phi_i, ex_iii);
-        t_calc.stop();
+        if (mpi::my_orb(phi_i)) {
+            Orbital V_ii;
+            calcExchange_kij(precf, phi_i, phi_i, phi_i, ex_iii, nullptr, &V_ii);
+            if (store_pairs) store_pair(i, i, V_ii);
+        }
         Ex.push_back(ex_iii);
     }
     mrcpp::print::time(4, "Exchange time diagonal", timerD);
 
+    // orbitals fetched in one task are kept for the following tasks as far as memory allows,
+    // the remaining budget is shared with the block orbitals and their contributions
+    int cache_size = 2 * block_size;
+    if (memory_utils::has_budget()) {
+        cache_size = memory_utils::get_chunk_size(N, orb_mb, mpi::comm_orb) - 2 * block_size;
+        cache_size = std::min(N, std::max(block_size + 1, cache_size));
+    }
+    OrbitalVector replicas;
+    if (useReplicas(N, orb_mb)) replicas = setupReplicas();
+    OrbitalCache cache(PhiBank, cache_size, replicas);
+
+    // compute K_iij and K_jji in one operation
+    auto calc_pair = [&](int i, int j, Orbital &ex_iij, Orbital &ex_jji) {
+        // fetch also own orbitals (simpler for clean up, and they are few)
+        Orbital phi_i = (bank_size > 0) ? cache.get(i) : Phi[i];
+        Orbital phi_j = (bank_size > 0) ? cache.get(j) : Phi[j];
+        Orbital V_ij;
+        calcExchange_kij(precf, phi_i, phi_i, phi_j, ex_iij, &ex_jji, &V_ij);
+        if (store_pairs) store_pair(i, j, V_ij);
+    };
+    double t_wait = runPairTasks(prec, block_size, calc_pair);
+    if (store_pairs) mpi::allreduce_vector(this->pairs->norms, mpi::comm_orb);
+
+    IntVector sizes = IntVector::Zero(2 * N);
+    for (int j = 0; j < N; j++) {
+        if (not mpi::my_orb(Phi[j])) continue;
+        sizes[j] = Ex[j].getNNodes(NUMBER::Total);
+        sizes[j + N] = Ex[j].getSizeNodes(NUMBER::Total);
+    }
+    mrcpp::print::time(4, "Time rcv orbitals", cache.t_fetch);
+    println(4, " Exchange block size " << block_size << ", orbitals reused " << cache.hits << " fetched " << cache.misses);
+
+    auto t = timerT.elapsed();
+    tuneBlockSize(N, t, cache.t_fetch.elapsed(), t_wait);
+    mpi::allreduce_vector(sizes, mpi::comm_orb);
+    long long nsum = 0;
+    for (int j = 0; j < N; j++) nsum += sizes[j];
+    long long msum = 0;
+    for (int j = 0; j < N; j++) msum += sizes[j + N];
+    int n = nsum / N;
+    int m = msum / N;
+    mrcpp::print::tree(2, "HF exchange (av.)", n, m, t);
+    if (this->use_ace) setupACE();
+    if (store_pairs) {
+        saveReference(this->apply_prec, true);
+    } else {
+        clearReference();
+    }
+}
+
+/** @brief Distributes the exchange contributions of the orbital pairs among the ranks
+ *
+ *  @param[in] prec precision used in the summation of the contributions
+ *  @param[in] block_size number of orbitals in each block of a task
+ *  @param[in] calc_pair computes the contributions of the pair (i,j) to K phi_j and K phi_i
+ *
+ * The contributions are added to this->exchange, which must be initialized by the
+ * caller with the diagonal terms. Returns the time spent waiting for the other ranks.
+ */
+double ExchangePotentialD1::runPairTasks(double prec, int block_size, const PairKernel &calc_pair) {
+    Timer timerS(false), t_calc(false), t_add(false), t_get(false), t_wait(false);
+    OrbitalVector &Ex = this->exchange;
+    OrbitalVector &Phi = *this->orbitals;
+    const auto &order = this->spatial_order;
+    BankAccount ExBank;
+    int N = Phi.size();
+
     // We divide all the exchange contributions into a fixed number of tasks.
     // all "j" orbitals are fetched and stored, and used together with one "i" orbital
     // At the end of a task, the Exchange for j is summed up with the contributions
@@ -178,9 +416,8 @@ void ExchangePotentialD1::setupInternal(double prec) {
     // make a set of tasks
     // We use symmetry: each pair (i,j) must be used once only. Only j<i
     // Divide into square blocks, with the diagonal blocks taken at the end (because they are faster to compute)
-    int block_size; // NB: block_size*block_size intermediate exchange results are stored temporarily
-    block_size = std::min(16, std::max(2, static_cast<int>(std::sqrt(N * N / (14 * orb_size)))));
-
+    // The blocks are taken over the spatially sorted orbitals, so that distant pairs are in separate blocks
+    // NB: block_size*block_size intermediate exchange results are stored temporarily
     int iblocks = (N + block_size - 1) / block_size;
     int ntasksmax = ((iblocks - 1) * iblocks) / 2 + iblocks * (block_size * (block_size - 1) / 2);
     std::vector<std::vector<int>> itasks(ntasksmax); // the i values (orbitals) of each block
@@ -203,9 +440,9 @@ void ExchangePotentialD1::setupInternal(double prec) {
                 if ((i0 + j0) % 2 != 0) jjj = j0 * block_size + (block_size - 1 - jj); // reversed order
                 if (jjj >= N) continue;
                 if ((i0 + j0) % 2 == 0)
-                    jtasks[task].push_back(jjj);
+                    jtasks[task].push_back(order[jjj]);
                 else
-                    itasks[task].push_back(jjj);
+                    itasks[task].push_back(order[jjj]);
             }
             for (int ii = 0; ii < block_size; ii++) {
                 int iii = i0 * block_size + ii;
@@ -213,9 +450,9 @@ void ExchangePotentialD1::setupInternal(double prec) {
                 if (iii >= N) continue;
 
                 if ((i0 + j0) % 2 == 0)
-                    itasks[task].push_back(iii);
+                    itasks[task].push_back(order[iii]);
                 else
-                    jtasks[task].push_back(iii);
+                    jtasks[task].push_back(order[iii]);
             }
             task++;
             if (task >= (iblocks * (iblocks - 1) / 2)) break;
@@ -230,64 +467,94 @@ void ExchangePotentialD1::setupInternal(double prec) {
         for (int jj = j; jj < j + block_size and jj < N; jj++) {
             for (int ii = i; ii < i + block_size and ii < N; ii++) {
                 if (ii <= jj) continue; // only jj<ii is computed
-                itasks[task].push_back(ii);
-                jtasks[task].push_back(jj);
+                itasks[task].push_back(order[ii]);
+                jtasks[task].push_back(order[jj]);
                 task++;
             }
         }
     }
     assert(task <= ntasksmax);
-    int ntasks = task;
+
+    // remove the tasks without any neighboring pairs
+    int ntasks = 0;
+    for (int t = 0; t < task; t++) {
+        bool has_pairs = false;
+        for (int i : itasks[t]) {
+            for (int j : jtasks[t]) has_pairs = has_pairs or isNeighbor(i, j);
+        }
+        if (not has_pairs) continue;
+        itasks[ntasks] = itasks[t];
+        jtasks[ntasks] = jtasks[t];
+        ntasks++;
+    }
+
+    // The end of each task is flagged to the owners of its orbitals, under the index
+    // N + owner rank. A rank counts the tasks involving its own orbitals, and is done
+    // when all of them are flagged, independently of the other tasks.
+    std::vector<std::vector<int>> towners(ntasks);
+    int n_pending = 0;
+    for (int t = 0; t < ntasks; t++) {
+        std::set<int> owners;
+        for (int i : itasks[t]) owners.insert(Phi[i].rankID());
+        for (int j : jtasks[t]) owners.insert(Phi[j].rankID());
+        for (int r : owners) {
+            if (r >= 0) towners[t].push_back(r);
+        }
+        if (owners.count(mpi::orb_rank) > 0) n_pending++;
+    }
 
     TaskManager tasksMaster(ntasks);
-    while (true) {
-        task = tasksMaster.next_task();
-        if (task < 0) break;
-        // we fetch all required i (but only one j at a time)
-        OrbitalVector iorb_vec;
-        int i0 = -1;
-        for (int i = 0; i < itasks[task].size(); i++) {
-            int iorb = itasks[task][i];
-            i0 = iorb;
-            Orbital phi_i;
-
-            timerR.resume();
-            if (bank_size > 0) {
-                PhiBank.get_orb(iorb, phi_i, 1); // fetch also own orbitals (simpler for clean up, and they are few)
-                iorb_vec.push_back(phi_i);
-            } else {
-                iorb_vec.push_back(Phi[iorb]);
+
+    // The contributions to the own orbitals are added in place (on the union grid)
+    // as soon as they are ready, between the tasks and while waiting for the others
+    // to finish.
+    auto accumulateOwn = [&]() {
+        int n_rcv = 0;
+        for (int j = 0; j < N; j++) {
+            if (not mpi::my_orb(Phi[j])) continue;
+            std::vector<int> iVec = tasksMaster.get_readytask(j, 1);
+            for (int i : iVec) {
+                if (i < 0) continue;
+                t_get.resume();
+                Orbital ex_rcv;
+                int found = ExBank.get_orb_del(j + i * N, ex_rcv);
+                t_get.stop();
+                if (not found) MSG_ERROR("My Exchange not found in Bank");
+                t_add.resume();
+                Ex[j].add(getSpinFactor(ex_rcv, Phi[j]), ex_rcv);
+                t_add.stop();
+                n_rcv++;
             }
-            timerR.stop();
+            if (iVec.size() > 0) Ex[j].crop(prec);
         }
+        return n_rcv;
+    };
 
-        for (int j = 0; j < jtasks[task].size(); j++) {
-            int jorb = jtasks[task][j];
-            Orbital phi_j;
-            timerR.resume();
-            if (bank_size > 0)
-                PhiBank.get_orb(jorb, phi_j, 1);
-            else
-                phi_j = Phi[jorb];
-            timerR.stop();
+    while (true) {
+        task = tasksMaster.next_task();
+        if (task < 0) break;
+        int i0 = (itasks[task].size() > 0) ? itasks[task].back() : -1;
+        for (int jorb : jtasks[task]) {
             QMFunctionVector iijfunc_vec;
-            ComplexVector coef_vec(N);
-            for (int i = 0; i < iorb_vec.size(); i++) {
-                int iorb = itasks[task][i];
-                Orbital &phi_i = iorb_vec[i];
-                Orbital ex_jji = phi_i.paramCopy();
-                Orbital ex_iij = phi_j.paramCopy();
-
-                // compute K_iij and K_jji in one operation
+            std::vector<ComplexDouble> coef_vec;
+            for (int iorb : itasks[task]) {
+                if (not isNeighbor(iorb, jorb)) continue;
+                // no exchange between orbitals of opposite spin
+                double j_fac = getSpinFactor(Phi[iorb], Phi[jorb]);
+                if (std::abs(j_fac) < mrcpp::MachineZero) continue;
+
+                Orbital ex_jji = Phi[iorb].paramCopy();
+                Orbital ex_iij = Phi[jorb].paramCopy();
                 t_calc.resume();
-                calcExchange_kij(precf, phi_i, phi_i, phi_j, ex_iij, &ex_jji);
+                calc_pair(iorb, jorb, ex_iij, ex_jji);
                 t_calc.stop();
-                double j_fac = getSpinFactor(phi_i, phi_j);
-                if (ex_iij.norm() > prec) coef_vec[iijfunc_vec.size()] = j_fac;
                 timerS.resume();
                 if (bank_size > 0) {
                     // store ex_jji
-                    if (ex_iij.norm() > prec) iijfunc_vec.push_back(ex_iij);
+                    if (ex_iij.norm() > prec) {
+                        coef_vec.push_back(j_fac);
+                        iijfunc_vec.push_back(ex_iij);
+                    }
                     if (ex_jji.norm() > prec) ExBank.put_orb(iorb + jorb * N, ex_jji);
                     if (ex_jji.norm() > prec) tasksMaster.put_readytask(iorb, jorb);
                 } else {
@@ -297,29 +564,26 @@ void ExchangePotentialD1::setupInternal(double prec) {
                 ex_jji.free(NUMBER::Total);
                 timerS.stop();
             }
-            Timer timerx;
             // fetch ready contributions to ex_j from others
             std::vector<int> iVec = tasksMaster.get_readytask(jorb, 1);
-            int lastsize = iVec.size();
             for (int iorb : iVec) {
                 t_get.resume();
                 Orbital ex_rcv;
                 int found = ExBank.get_orb_del(jorb + iorb * N, ex_rcv);
                 t_get.stop();
                 if (not found) MSG_ERROR("Exchange not found");
-                double j_fac = getSpinFactor(ex_rcv, phi_j);
-                coef_vec[iijfunc_vec.size()] = j_fac;
+                coef_vec.push_back(getSpinFactor(ex_rcv, Phi[jorb]));
                 iijfunc_vec.push_back(ex_rcv);
             }
             // add all contributions to ex_j,
             if (bank_size > 0 and iijfunc_vec.size() > 0) {
-                Orbital ex_j = phi_j.paramCopy();
+                Orbital ex_j = Phi[jorb].paramCopy();
                 t_add.resume();
-                qmfunction::linear_combination(ex_j, coef_vec, iijfunc_vec, prec);
+                Eigen::Map<ComplexVector> coefs(coef_vec.data(), coef_vec.size());
+                qmfunction::linear_combination(ex_j, coefs, iijfunc_vec, prec);
                 t_add.stop();
                 // ex_j is sent to Bank
                 if (ex_j.hasReal() or ex_j.hasImag()) {
-                    auto tT = timerx.elapsed();
                     timerS.resume();
                     ex_j.crop(prec);
                     if (ex_j.norm() > prec) {
@@ -329,82 +593,369 @@ void ExchangePotentialD1::setupInternal(double prec) {
                     }
                     timerS.stop();
                     ex_j.free(NUMBER::Total);
-                } else if (iijfunc_vec.size() > 0) {
+                } else {
                     MSG_ERROR("Exchange exists but has no real and no Imag parts");
                 }
                 for (int jj = 0; jj < iijfunc_vec.size(); jj++) iijfunc_vec[jj].free(NUMBER::Total);
             }
         }
+        for (int r : towners[task]) tasksMaster.put_readytask(N + r, task);
+        if (bank_size > 0) accumulateOwn();
     }
 
-    // wait until all exchanges pieces are computed and stored in Bank
+    // wait until the tasks involving the own orbitals are finished, while their
+    // contributions are accumulated as they come in
     t_wait.resume();
-    mpi::barrier(mpi::comm_orb);
+    while (bank_size > 0) {
+        n_pending -= tasksMaster.get_readytask(N + mpi::orb_rank, 1).size();
+        int n_rcv = accumulateOwn();
+        if (n_pending <= 0) break;
+        if (n_rcv == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
     t_wait.stop();
 
-    IntVector sizes = IntVector::Zero(2 * N);
-    for (int j = 0; j < N; j++) {
-        if (not mpi::my_orb(Phi[j]) or bank_size == 0) continue; // fetch only own j
-        std::vector<int> iVec = tasksMaster.get_readytask(j, 1);
-        QMFunctionVector iijfunc_vec;
-        ComplexVector coef_vec(N);
-        int tot = 0;
-        int totmax = 2 * block_size;
-        for (int i : iVec) {
-            if (i < 0) continue;
-            t_get.resume();
-            Orbital ex_rcv;
-            int found = ExBank.get_orb_del(j + i * N, ex_rcv);
-            t_get.stop();
-            double j_fac = getSpinFactor(ex_rcv, Phi[j]);
-            coef_vec[iijfunc_vec.size()] = j_fac;
-            iijfunc_vec.push_back(ex_rcv);
-            if (not found) MSG_ERROR("My Exchange not found in Bank");
-            tot++;
-            if (tot >= totmax) {
-                // we sum the contributions so far before fetching new ones
-                t_add.resume();
-                auto tmp_j = Ex[j].paramCopy();
-                qmfunction::linear_combination(tmp_j, coef_vec, iijfunc_vec, prec);
-                Ex[j].add(1.0, tmp_j);
-                tmp_j.free(NUMBER::Total);
-                for (int jj = 0; jj < iijfunc_vec.size(); jj++) iijfunc_vec[jj].free(NUMBER::Total);
-                iijfunc_vec.clear();
-                Ex[j].crop(prec);
-                t_add.stop();
-                tot = 0;
-            }
-        }
-        if (iijfunc_vec.size() > 0) {
-            t_add.resume();
-            auto tmp_j = Ex[j].paramCopy();
-            qmfunction::linear_combination(tmp_j, coef_vec, iijfunc_vec, prec);
-            Ex[j].add(1.0, tmp_j);
-            tmp_j.free(NUMBER::Total);
-            for (int jj = 0; jj < iijfunc_vec.size(); jj++) iijfunc_vec[jj].free(NUMBER::Total);
-            Ex[j].crop(prec);
-            t_add.stop();
-        }
-        sizes[j] = Ex[j].getNNodes(NUMBER::Total);
-        sizes[j + N] = Ex[j].getSizeNodes(NUMBER::Total);
-    }
-    mrcpp::print::time(4, "Time rcv orbitals", timerR);
     mrcpp::print::time(4, "Time send exchanges", timerS);
     mrcpp::print::time(4, "Time rcv exchanges", t_get);
     mrcpp::print::time(4, "Time wait others finished", t_wait);
     mrcpp::print::time(4, "Time add exchanges", t_add);
     mrcpp::print::time(4, "Time calculate exchanges", t_calc);
+    return t_wait.elapsed();
+}
 
-    auto t = timerT.elapsed();
+/** @brief Block size for the exchange tasks
+ *
+ *  @param[in] N number of orbitals
+ *  @param[in] orb_mb average orbital size (MB)
+ *
+ * The blocks are chosen to give a target number of tasks per rank, which
+ * is tuned from the timings of the previous setups. During a task the
+ * orbitals of a block and their exchange contributions are held in memory,
+ * so the block size is also limited by the memory budget of each rank.
+ */
+int ExchangePotentialD1::calcBlockSize(int N, double orb_mb) const {
+    int block_size = static_cast<int>(std::sqrt(N * N / (2.0 * this->tasks_per_rank * orb_size)));
+    int block_max = memory_utils::get_chunk_size(16, 2.0 * orb_mb, mpi::comm_orb);
+    return std::min(block_max, std::max(2, block_size));
+}
+
+/** @brief Adjust the number of tasks per rank for the next setup
+ *
+ *  @param[in] N number of orbitals
+ *  @param[in] t_tot total time of the setup
+ *  @param[in] t_fetch time spent fetching orbitals
+ *  @param[in] t_wait time spent waiting for the other ranks to finish
+ *
+ * More and smaller tasks are used if the ranks spend time idle at the end,
+ * fewer and larger tasks if the time is dominated by fetching orbitals. The
+ * rank averages are used, so all ranks make the same decision.
+ */
+void ExchangePotentialD1::tuneBlockSize(int N, double t_tot, double t_fetch, double t_wait) {
+    if (orb_size < 2 or t_tot <= 0.0) return;
+    DoubleVector fracs(2);
+    fracs << t_wait / t_tot, t_fetch / t_tot;
+    mpi::allreduce_vector(fracs, mpi::comm_orb);
+    fracs /= orb_size;
+
+    double max_tasks = 0.5 * N * N / orb_size;
+    if (fracs(0) > 0.1) {
+        this->tasks_per_rank = std::min(1.5 * this->tasks_per_rank, max_tasks);
+    } else if (fracs(1) > 0.2) {
+        this->tasks_per_rank = std::max(this->tasks_per_rank / 1.5, 1.0);
+    }
+    println(4, " Exchange tasks per rank " << this->tasks_per_rank);
+}
+
+/** @brief updates the precomputed exchange potential from the orbital changes
+ *
+ *  @param[in] prec precision used in the construction
+ *
+ * With dphi_i = phi_i - phi_i^ref the change of orbital i since the reference was
+ * computed, and V_ij = P[phi_i^ref^dag phi_j^ref] the stored pair potentials, the
+ * pair densities change by
+ *
+ * drho_ij = dphi_i^dag phi_j + phi_i^ref^dag dphi_j
+ *
+ * and with dV_ij = P[drho_ij] the exchange applied to orbital j is updated exactly as
+ *
+ * K phi_j = K^ref phi_j^ref + sum_i [ dphi_i (V_ij + dV_ij) + phi_i^ref dV_ij ]
+ *
+ * The Poisson operator is only applied to the pair density changes, to the same
+ * absolute precision as the full pair potentials, which is a relative precision
+ * loosened by ||rho_ij|| / ||drho_ij||. The pair potentials are replaced by
+ * V_ij + dV_ij for the next update. Each pair contributes to both orbitals, and is
+ * treated once within the same block tasks as the full build. Pairs where neither
+ * orbital changed by more than the exchange precision are skipped. The truncation
+ * errors accumulate over the updates, which is why the exchange is periodically
+ * rebuilt.
+ */
+void ExchangePotentialD1::updateInternal(double prec) {
+    Timer timerT;
+    setApplyPrec(prec);
+    if (this->exchange.size() != 0) MSG_ERROR("Exchange not properly cleared");
+
+    mrcpp::ConvolutionOperator<3> &P = *this->poisson;
+    OrbitalVector &Ex = this->exchange;
+    OrbitalVector &Phi = *this->orbitals;
+    OrbitalVector &Phi_ref = this->ref_orbitals;
+    int N = Phi.size();
+    // use fixed exchange_prec if set explicitly, otherwise use setup prec
+    double precf = (this->exchange_prec > 0.0) ? this->exchange_prec : prec;
+    prec = mpi::numerically_exact ? -1.0 : prec;
+    precf /= std::sqrt(1.0 * N);
+    setupNeighbors(precf);
+
+    // orbital changes since the reference, changes below precf are neglected
+    OrbitalVector dPhi = orbital::add(1.0, Phi, -1.0, Phi_ref, -1.0);
+    DoubleVector dNorms = orbital::get_norms(dPhi);
+    int n_changed = 0;
+    for (int i = 0; i < N; i++) n_changed += (dNorms(i) > precf);
+
+    // the reference and changes of other ranks are fetched from the bank
+    BankAccount RefBank;
+    BankAccount DeltaBank;
+    if (bank_size > 0) {
+        for (int i = 0; i < N; i++) {
+            if (not mpi::my_orb(Phi[i])) continue;
+            RefBank.put_orb(i, Phi_ref[i]);
+            if (dNorms(i) > precf) DeltaBank.put_orb(i, dPhi[i]);
+        }
+    }
+
+    DoubleVector orb_kb = DoubleVector::Constant(1, orbital::get_size_nodes(Phi));
+    mpi::allreduce_vector(orb_kb, mpi::comm_orb);
+    double orb_mb = orb_kb(0) / (1024.0 * N);
+    int block_size = calcBlockSize(N, orb_mb);
+
+    // the current, reference and changed orbitals share the cache budget
+    int cache_size = 2 * block_size;
+    if (memory_utils::has_budget()) {
+        cache_size = (memory_utils::get_chunk_size(N, orb_mb, mpi::comm_orb) - 2 * block_size) / 3;
+        cache_size = std::min(N, std::max(block_size + 1, cache_size));
+    }
+    OrbitalVector no_replicas;
+    OrbitalCache phi_cache(PhiBank, cache_size, no_replicas);
+    OrbitalCache ref_cache(RefBank, cache_size, no_replicas);
+    OrbitalCache delta_cache(DeltaBank, cache_size, no_replicas);
+    auto fetch = [](OrbitalCache &cache, OrbitalVector &vec, int i) {
+        return (bank_size > 0 and not mpi::my_orb(vec[i])) ? cache.get(i) : vec[i];
+    };
+
+    // contributions of the pair (i,j) to K phi_j, and optionally to K phi_i
+    DoubleVector norm_changes = DoubleVector::Zero(N * N);
+    auto update_pair = [&](int i, int j, Orbital &ex_iij, Orbital *ex_jji) {
+        bool changed_i = (dNorms(i) > precf);
+        bool changed_j = (dNorms(j) > precf);
+        if (not(changed_i or changed_j)) return;
+        Orbital ref_i = fetch(ref_cache, Phi_ref, i);
+        Orbital ref_j = fetch(ref_cache, Phi_ref, j);
+        Orbital dphi_i = (changed_i) ? fetch(delta_cache, dPhi, i) : Orbital();
+        Orbital dphi_j = (changed_j) ? fetch(delta_cache, dPhi, j) : Orbital();
+
+        // drho_ij = dphi_i^dag phi_j + phi_i^ref^dag dphi_j
+        QMFunctionVector rho_vec;
+        if (changed_i) {
+            Orbital phi_j = fetch(phi_cache, Phi, j);
+            Orbital rho_1 = ref_j.paramCopy();
+            qmfunction::multiply(rho_1, dphi_i.dagger(), phi_j, precf / 10, true, true);
+            rho_vec.push_back(rho_1);
+        }
+        if (changed_j) {
+            Orbital rho_2 = ref_j.paramCopy();
+            qmfunction::multiply(rho_2, ref_i.dagger(), dphi_j, precf / 10, true, true);
+            rho_vec.push_back(rho_2);
+        }
+        Orbital drho_ij = ref_j.paramCopy();
+        qmfunction::linear_combination(drho_ij, ComplexVector::Ones(rho_vec.size()), rho_vec, -1.0);
+        rho_vec.clear();
+
+        // dV_ij = P[drho_ij] at the absolute precision of the full pair potentials
+        Orbital dV_ij;
+        if (drho_ij.norm() >= precf) {
+            mrcpp::FunctionTreeVector<3> phi_opt_vec;
+            if (ref_i.hasReal()) phi_opt_vec.push_back(std::make_tuple(1.0, &ref_i.real()));
+            if (ref_i.hasImag()) phi_opt_vec.push_back(std::make_tuple(1.0, &ref_i.imag()));
+            if (ref_j.hasReal() and i != j) phi_opt_vec.push_back(std::make_tuple(1.0, &ref_j.real()));
+            if (ref_j.hasImag() and i != j) phi_opt_vec.push_back(std::make_tuple(1.0, &ref_j.imag()));
+            dV_ij = drho_ij.paramCopy();
+            if (drho_ij.hasReal()) {
+                dV_ij.alloc(NUMBER::Real);
+                mrcpp::apply(precf * 10, dV_ij.real(), P, drho_ij.real(), phi_opt_vec, -1, true);
+            }
+            if (drho_ij.hasImag()) {
+                dV_ij.alloc(NUMBER::Imag);
+                mrcpp::apply(precf * 10, dV_ij.imag(), P, drho_ij.imag(), phi_opt_vec, -1, true);
+            }
+        }
+        drho_ij.release();
+
+        // updated pair potential V_ij + dV_ij, the old one is taken out of the storage
+        int ij = std::min(i, j) + std::max(i, j) * N;
+        bool has_ref = (this->pairs->norms(ij) > 0.0);
+        bool has_dV = (dV_ij.hasReal() or dV_ij.hasImag());
+        Orbital V_ij;
+        if (has_ref) V_ij = getPairPotential(i, j, has_dV);
+        if (has_dV) {
+            QMFunctionVector pot_vec;
+            if (has_ref) pot_vec.push_back(V_ij);
+            pot_vec.push_back(dV_ij);
+            Orbital V_new = ref_j.paramCopy();
+            qmfunction::linear_combination(V_new, ComplexVector::Ones(pot_vec.size()), pot_vec, prec);
+            if (has_ref and bank_size > 0) V_ij.free(NUMBER::Total);
+            V_ij = V_new;
+        }
+        bool has_V = (V_ij.hasReal() or V_ij.hasImag());
+
+        // K phi_j += dphi_i V_ij + phi_i^ref dV_ij
+        QMFunctionVector j_vec;
+        if (changed_i and has_V) {
+            Orbital ex_1 = ref_j.paramCopy();
+            qmfunction::multiply(ex_1, dphi_i, V_ij, precf / 100, true, true);
+            j_vec.push_back(ex_1);
+        }
+        if (has_dV) {
+            Orbital ex_2 = ref_j.paramCopy();
+            qmfunction::multiply(ex_2, ref_i, dV_ij, precf / 100, true, true);
+            j_vec.push_back(ex_2);
+        }
+        if (j_vec.size() > 0) qmfunction::linear_combination(ex_iij, ComplexVector::Ones(j_vec.size()), j_vec, prec);
+
+        // K phi_i += dphi_j V_ij^dag + phi_j^ref dV_ij^dag
+        QMFunctionVector i_vec;
+        if (ex_jji != nullptr and changed_j and has_V) {
+            Orbital ex_3 = ref_i.paramCopy();
+            qmfunction::multiply(ex_3, dphi_j, V_ij.dagger(), precf / 100, true, true);
+            i_vec.push_back(ex_3);
+        }
+        if (ex_jji != nullptr and has_dV) {
+            Orbital ex_4 = ref_i.paramCopy();
+            qmfunction::multiply(ex_4, ref_j, dV_ij.dagger(), precf / 100, true, true);
+            i_vec.push_back(ex_4);
+        }
+        if (i_vec.size() > 0) qmfunction::linear_combination(*ex_jji, ComplexVector::Ones(i_vec.size()), i_vec, prec);
+
+        if (has_dV) {
+            norm_changes(ij) = V_ij.norm() - this->pairs->norms(ij);
+            putPairPotential(i, j, V_ij);
+        } else if (has_ref and bank_size > 0) {
+            V_ij.free(NUMBER::Total);
+        }
+    };
+
+    // start from the reference exchange and add the own diagonal terms
+    Timer timerD;
+    for (int i = 0; i < N; i++) {
+        Orbital ex_i = Phi[i].paramCopy();
+        if (mpi::my_orb(Phi[i])) {
+            qmfunction::deep_copy(ex_i, this->ref_exchange[i]);
+            Orbital ex_iii = Phi[i].paramCopy();
+            update_pair(i, i, ex_iii, nullptr);
+            ex_i.add(1.0, ex_iii);
+        }
+        Ex.push_back(ex_i);
+    }
+    mrcpp::print::time(4, "Exchange time diagonal", timerD);
+
+    auto calc_pair = [&](int i, int j, Orbital &ex_iij, Orbital &ex_jji) { update_pair(i, j, ex_iij, &ex_jji); };
+    double t_wait = runPairTasks(prec, block_size, calc_pair);
+    mpi::allreduce_vector(norm_changes, mpi::comm_orb);
+    this->pairs->norms += norm_changes;
+    for (int j = 0; j < N; j++) {
+        if (mpi::my_orb(Phi[j])) Ex[j].crop(prec);
+    }
+    // the bank accounts must stay open until all ranks are done
+    mpi::barrier(mpi::comm_orb);
+    double t_fetch = phi_cache.t_fetch.elapsed() + ref_cache.t_fetch.elapsed() + delta_cache.t_fetch.elapsed();
+    println(4, " Time rcv orbitals " << t_fetch);
+
+    IntVector sizes = IntVector::Zero(2 * N);
+    for (int j = 0; j < N; j++) {
+        if (not mpi::my_orb(Phi[j])) continue;
+        sizes[j] = Ex[j].getNNodes(NUMBER::Total);
+        sizes[j + N] = Ex[j].getSizeNodes(NUMBER::Total);
+    }
     mpi::allreduce_vector(sizes, mpi::comm_orb);
-    long long nsum = 0;
-    for (int j = 0; j < N; j++) nsum += sizes[j];
-    long long msum = 0;
-    for (int j = 0; j < N; j++) msum += sizes[j + N];
-    int n = nsum / N;
-    int m = msum / N;
-    mrcpp::print::tree(2, "HF exchange (av.)", n, m, t);
-} // namespace mrchem
+    auto t = timerT.elapsed();
+    tuneBlockSize(N, t, t_fetch, t_wait);
+    int n = sizes.head(N).cast<long long>().sum() / N;
+    int m = sizes.tail(N).cast<long long>().sum() / N;
+    println(3, " Exchange update from " << n_changed << " of " << N << " changed orbitals");
+    mrcpp::print::tree(2, "HF exchange update (av.)", n, m, t);
+    saveReference(this->apply_prec, false);
+}
+
+/** @brief Builds the adaptively compressed exchange (ACE) operator
+ *
+ * With W_i = K phi_i the precomputed exchange, the exchange matrix M = <phi|W> is
+ * Hermitian and positive definite (K is here the positive operator that enters the
+ * Fock operator with a minus sign), and with its Cholesky decomposition M = L L^dagger
+ * the projector functions xi = W L^-dagger give
+ *
+ * K_ACE = sum_k |xi_k><xi_k| = |W> M^-1 <W|
+ *
+ * which agrees with K when applied to any function in the span of the orbitals.
+ * The projector functions are stored in the bank, and the compressed operator is
+ * applied to other functions with only overlaps and a linear combination. The
+ * matrix M is kept as the exchange matrix among the orbitals for the Fock matrix
+ * and the energy. If M is not positive definite, the compressed exchange is skipped.
+ */
+void ExchangePotentialD1::setupACE() {
+    Timer timer;
+    OrbitalVector &Phi = *this->orbitals;
+    OrbitalVector &W = this->exchange;
+    int N = Phi.size();
+
+    ComplexMatrix M = orbital::calc_overlap_matrix(Phi, W);
+    M = 0.5 * (M + M.adjoint());
+    Eigen::LLT<ComplexMatrix> llt(M);
+    if (llt.info() != Eigen::Success) {
+        MSG_WARN("Exchange matrix not positive definite, skipping ACE");
+        this->ace.clear();
+        return;
+    }
+    // xi_k = sum_i W_i (L^-dagger)_ik
+    ComplexMatrix L_inv = llt.matrixL().solve(ComplexMatrix::Identity(N, N));
+    this->ace = orbital::rotate(W, L_inv.adjoint(), this->apply_prec);
+    this->internal_matrix = M;
+
+    if (bank_size > 0) {
+        AceBank.clear();
+        for (int k = 0; k < N; k++) {
+            if (mpi::my_orb(this->ace[k])) AceBank.put_orb(k, this->ace[k]);
+        }
+        mpi::barrier(mpi::comm_orb);
+    }
+    mrcpp::print::time(2, "Computing compressed exchange", timer);
+}
+
+/** @brief Applies the compressed exchange to a given orbital
+ *
+ *  \param[in] phi_p input orbital
+ *
+ * K_ACE|phi_p> = sum_k xi_k <xi_k|phi_p>, with the projector functions
+ * of other ranks fetched from the bank.
+ */
+Orbital ExchangePotentialD1::calcCompressedExchange(Orbital phi_p) {
+    Timer timer;
+    OrbitalVector &Xi = this->ace;
+    int N = Xi.size();
+
+    QMFunctionVector func_vec;
+    ComplexVector coef_vec = ComplexVector::Zero(N);
+    for (int k = 0; k < N; k++) {
+        Orbital xi_k = Xi[k];
+        if (not mpi::my_orb(xi_k)) AceBank.get_orb(k, xi_k, 1);
+        coef_vec(k) = orbital::dot(xi_k, phi_p);
+        func_vec.push_back(xi_k);
+    }
+
+    Orbital ex_p = phi_p.paramCopy();
+    qmfunction::linear_combination(ex_p, coef_vec, func_vec, this->apply_prec);
+    for (int k = 0; k < N; k++) {
+        if (not mpi::my_orb(Xi[k])) func_vec[k].free(NUMBER::Total);
+    }
+    print_utils::qmfunction(3, "Applied compressed exchange", ex_p, timer);
+    return ex_p;
+}
 
 /** @brief Computes the exchange potential on the fly
  *
@@ -423,19 +974,25 @@ Orbital ExchangePotentialD1::calcExchange(Orbital phi_p) {
     // adjust precision since we sum over orbitals
     precf /= std::min(10.0, std::sqrt(1.0 * Phi.size()));
 
+    // pairs are screened against the cell norms of the internal orbitals
+    bool use_bound = (this->cell_norms.size() == Phi.size());
+    qmfunction::CellNormTable cells_p;
+    if (use_bound) cells_p = qmfunction::calc_cell_norms(phi_p);
+
     QMFunctionVector func_vec;
     std::vector<ComplexDouble> coef_vec;
     for (int i = 0; i < Phi.size(); i++) {
+        double spin_fac = getSpinFactor(Phi[i], phi_p);
+        if (std::abs(spin_fac) < mrcpp::MachineZero) continue;
+        if (use_bound and qmfunction::calc_product_bound(this->cell_norms[i], cells_p) < precf) continue;
+
         Orbital &phi_i = Phi[i];
         if (not mpi::my_orb(phi_i)) PhiBank.get_orb(i, phi_i, 1);
 
-        double spin_fac = getSpinFactor(phi_i, phi_p);
-        if (std::abs(spin_fac) >= mrcpp::MachineZero) {
-            Orbital ex_iip = phi_p.paramCopy();
-            calcExchange_kij(precf, phi_i, phi_i, phi_p, ex_iip);
-            coef_vec.push_back(spin_fac / phi_i.squaredNorm());
-            func_vec.push_back(ex_iip);
-        }
+        Orbital ex_iip = phi_p.paramCopy();
+        calcExchange_kij(precf, phi_i, phi_i, phi_p, ex_iip);
+        coef_vec.push_back(spin_fac / phi_i.squaredNorm());
+        func_vec.push_back(ex_iip);
 
         if (not mpi::my_orb(phi_i)) phi_i.free(NUMBER::Total);
     }
@@ -448,4 +1005,133 @@ Orbital ExchangePotentialD1::calcExchange(Orbital phi_p) {
     return ex_p;
 }
 
+/** @brief Check if the exchange matrix can be taken from the pair potentials
+ *
+ * @param[in] Phi orbitals on both sides of the matrix
+ *
+ * Only used when the exchange is computed on-the-fly or in compressed form,
+ * and only for the orbitals that define the operator.
+ */
+bool ExchangePotentialD1::useInternalMatrix(const OrbitalVector &Phi) const {
+    if (this->apply_prec < 0.0) return false;
+    if (&Phi != this->orbitals.get()) return false;
+    return (this->exchange.size() == 0 or this->ace.size() == Phi.size());
+}
+
+/** @brief Exchange matrix among the defining orbitals, computed from the pair potentials
+ *
+ * The matrix elements are integrated directly from the pair densities and potentials
+ *
+ * K_pq = <phi_p|K|phi_q> = sum_j c_jq <rho_jp|V_jq>
+ *
+ * where rho_jp = phi_j^dag * phi_p, V_jq = P[rho_jq] and c_jq = spin_fac/||phi_j||^2.
+ * Each rank treats its own orbitals j and forms the pairs with all the orbitals in one
+ * pass, which takes the same number of Poisson solves as a single application of the
+ * operator, without forming K|phi_q>. Since <rho_jp|V_jq> = <rho_jq|V_jp>^*, each pair
+ * (p,q) is integrated only once. Pairs outside the neighbor list are skipped. The matrix
+ * is kept until the next setup, so the Fock matrix and the energy share the same build.
+ *
+ * With the compressed exchange, the matrix is built with the ACE, and after a rotation
+ * of the orbitals it is recomputed from the overlaps C_kq = <xi_k|phi_q> as C^dagger C.
+ */
+ComplexMatrix ExchangePotentialD1::getInternalMatrix() {
+    if (this->internal_matrix.size() > 0) return this->internal_matrix;
+    if (this->apply_prec < 0.0) MSG_ERROR("Uninitialized operator");
+    Timer timer;
+    mrcpp::ConvolutionOperator<3> &P = *this->poisson;
+    OrbitalVector &Phi = *this->orbitals;
+    int N = Phi.size();
+
+    if (this->ace.size() == N) {
+        ComplexMatrix C = orbital::calc_overlap_matrix(this->ace, Phi);
+        this->internal_matrix = C.adjoint() * C;
+        mrcpp::print::time(2, "Compressed exchange matrix", timer);
+        return this->internal_matrix;
+    }
+
+    // same precision as in calcExchange
+    double precf = (this->exchange_prec > 0.0) ? this->exchange_prec : this->apply_prec;
+    precf /= std::min(10.0, std::sqrt(1.0 * N));
+
+    auto is_zero = [](const Orbital &phi) { return not(phi.hasReal() or phi.hasImag()); };
+
+    int n_pairs = 0;
+    int n_pots = 0;
+    ComplexMatrix K = ComplexMatrix::Zero(N, N);
+    for (int j = 0; j < N; j++) {
+        Orbital &phi_j = Phi[j];
+        if (not mpi::my_orb(phi_j)) continue;
+
+        // neighbors of j at this precision, the pair screening of the setup is left untouched
+        std::vector<int> nbrs_j;
+        for (int q = 0; q < N; q++) {
+            if (std::abs(getSpinFactor(phi_j, Phi[q])) < mrcpp::MachineZero) continue;
+            if (q != j and isNegligiblePair(j, q, precf)) continue;
+            nbrs_j.push_back(q);
+        }
+
+        // pair densities with the orbitals of the same spin as j, and their potentials,
+        // both the bra (p) and the ket (q) side vanish for orthogonal spins
+        DoubleVector c_j = DoubleVector::Zero(N);
+        std::vector<Orbital> rho_j(N);
+        std::vector<Orbital> V_j(N);
+        for (int q : nbrs_j) {
+            Orbital &phi_q = Phi[q];
+            if (not mpi::my_orb(phi_q)) PhiBank.get_orb(q, phi_q, 1);
+
+            c_j(q) = getSpinFactor(phi_j, phi_q) / phi_j.squaredNorm();
+            Orbital rho_jq = phi_q.paramCopy();
+            qmfunction::multiply(rho_jq, phi_j.dagger(), phi_q, precf / 10, true, true);
+            if (rho_jq.norm() >= precf) rho_j[q] = rho_jq;
+            if (not is_zero(rho_j[q])) {
+                mrcpp::FunctionTreeVector<3> phi_opt_vec;
+                if (phi_j.hasReal()) phi_opt_vec.push_back(std::make_tuple(1.0, &phi_j.real()));
+                if (phi_j.hasImag()) phi_opt_vec.push_back(std::make_tuple(1.0, &phi_j.imag()));
+                if (phi_q.hasReal() and q != j) phi_opt_vec.push_back(std::make_tuple(1.0, &phi_q.real()));
+                if (phi_q.hasImag() and q != j) phi_opt_vec.push_back(std::make_tuple(1.0, &phi_q.imag()));
+
+                Orbital &rho_jq = rho_j[q];
+                Orbital V_jq = rho_jq.paramCopy();
+                if (rho_jq.hasReal()) {
+                    V_jq.alloc(NUMBER::Real);
+                    mrcpp::apply(precf * 10, V_jq.real(), P, rho_jq.real(), phi_opt_vec, -1, true);
+                }
+                if (rho_jq.hasImag()) {
+                    V_jq.alloc(NUMBER::Imag);
+                    mrcpp::apply(precf * 10, V_jq.imag(), P, rho_jq.imag(), phi_opt_vec, -1, true);
+                }
+                V_j[q] = V_jq;
+                n_pots++;
+            }
+
+            if (not mpi::my_orb(phi_q)) phi_q.free(NUMBER::Total);
+        }
+
+        // K_pq += c_jq <rho_jp|V_jq>, K_qp += c_jp <rho_jp|V_jq>^*
+        for (int q = 0; q < N; q++) {
+            for (int p = 0; p <= q; p++) {
+                ComplexDouble H_pq = 0.0;
+                if (not is_zero(V_j[q])) {
+                    if (is_zero(rho_j[p])) continue;
+                    H_pq = qmfunction::dot(rho_j[p], V_j[q]);
+                } else if (not is_zero(V_j[p])) {
+                    if (is_zero(rho_j[q])) continue;
+                    H_pq = std::conj(qmfunction::dot(rho_j[q], V_j[p]));
+                } else {
+                    continue;
+                }
+                K(p, q) += c_j(q) * H_pq;
+                if (p != q) K(q, p) += c_j(p) * std::conj(H_pq);
+                n_pairs++;
+            }
+        }
+    }
+    mpi::allreduce_matrix(K, mpi::comm_orb);
+    this->internal_matrix = K;
+
+    println(3, " Exchange matrix from " << n_pots << " pair potentials and " << n_pairs << " integrals");
+    mrcpp::print::time(2, "Exchange matrix from pairs", timer);
+    return this->internal_matrix;
+}
+
 } // namespace mrchem
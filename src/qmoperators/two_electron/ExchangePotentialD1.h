@@ -27,6 +27,8 @@
 
 #include <memory>
 
+#include <functional>
+
 #include "ExchangePotential.h"
 
 #include "qmfunctions/qmfunction_fwd.h"
@@ -43,24 +45,58 @@ namespace mrchem {
  * orbitals themselves are allowed to change in between each
  * application. The internal exchange potentials (the operator applied
  * to it's own orbitals) can be precomputed and stored for fast
- * retrieval.
+ * retrieval, and updated incrementally from one setup to the next.
+ *
+ * From the precomputed exchange, the adaptively compressed exchange (ACE)
+ * K_ACE = sum_k |xi_k><xi_k| can be built in each setup. It is exact within the
+ * span of the orbitals, gives the exchange matrix among them, and is applied to
+ * other functions without Poisson solves.
+ *
+ * With several MPI ranks on a node, the orbitals needed for the precomputation can
+ * be fetched from the bank once per node into MPI shared memory, where they are
+ * read by all the local ranks.
+ *
+ * Without precomputation, the exchange matrix among the defining orbitals is
+ * integrated directly from the pair potentials in a single pass.
  */
 
 class ExchangePotentialD1 final : public ExchangePotential {
 public:
-    ExchangePotentialD1(std::shared_ptr<mrcpp::PoissonOperator> P, std::shared_ptr<OrbitalVector> Phi, double prec);
+    ExchangePotentialD1(std::shared_ptr<mrcpp::ConvolutionOperator<3>> P,
+                        std::shared_ptr<OrbitalVector> Phi,
+                        double prec,
+                        bool mpi_share = false);
     ~ExchangePotentialD1() override = default;
 
     friend class ExchangeOperator;
 
 private:
-    BankAccount PhiBank; // to put the Orbitals
+    BankAccount PhiBank;         // to put the Orbitals
+    BankAccount AceBank;         // to put the ACE projector functions
+    OrbitalVector ace;           ///< Projector functions xi_k of the compressed exchange
+    double tasks_per_rank{7.0}; ///< Target number of exchange tasks per rank, tuned from previous setups
+    bool share_orbitals{false}; ///< Fetch the orbitals once per node into MPI shared memory
     void setupBank() override;
     void clearBank();
     int testInternal(Orbital phi_p) const override;
     void setupInternal(double prec) override;
+    void clearInternal() override;
+    void updateInternal(double prec);
+    void setupACE();
+    Orbital calcCompressedExchange(Orbital phi_p);
+
+    /** Computes the contributions of the pair (i,j) to K phi_j (ex_iij) and to K phi_i (ex_jji) */
+    using PairKernel = std::function<void(int i, int j, Orbital &ex_iij, Orbital &ex_jji)>;
+    double runPairTasks(double prec, int block_size, const PairKernel &calc_pair);
+    bool useReplicas(int N, double orb_mb) const;
+    OrbitalVector setupReplicas();
+    int calcBlockSize(int N, double orb_mb) const;
+    void tuneBlockSize(int N, double t_tot, double t_fetch, double t_wait);
     Orbital calcExchange(Orbital phi_p);
 
+    bool useInternalMatrix(const OrbitalVector &Phi) const override;
+    ComplexMatrix getInternalMatrix() override;
+
     ComplexDouble evalf(const mrcpp::Coord<3> &r) const override { return 0.0; }
 
     Orbital apply(Orbital phi_p) override;
@@ -23,6 +23,10 @@
  * <https://mrchem.readthedocs.io/>
  */
 
+#include <chrono>
+#include <set>
+#include <thread>
+
 #include "MRCPP/MWOperators"
 #include "MRCPP/Printer"
 #include "MRCPP/Timer"
@@ -38,8 +42,7 @@
 using mrcpp::Printer;
 using mrcpp::Timer;
 
-using PoissonOperator = mrcpp::PoissonOperator;
-using PoissonOperator_p = std::shared_ptr<mrcpp::PoissonOperator>;
+using ConvolutionOperator_p = std::shared_ptr<mrcpp::ConvolutionOperator<3>>;
 using OrbitalVector_p = std::shared_ptr<mrchem::OrbitalVector>;
 using QMOperator_p = std::shared_ptr<mrchem::QMOperator>;
 
@@ -47,10 +50,10 @@ namespace mrchem {
 
 /** @brief constructor
  *
- * @param[in] P Poisson operator (does not take ownership)
+ * @param[in] P interaction kernel, Poisson or attenuated (does not take ownership)
  * @param[in] Phi vector of orbitals which define the exchange operator
  */
-ExchangePotentialD2::ExchangePotentialD2(PoissonOperator_p P,
+ExchangePotentialD2::ExchangePotentialD2(ConvolutionOperator_p P,
                                          OrbitalVector_p Phi,
                                          OrbitalVector_p X,
                                          OrbitalVector_p Y,
@@ -93,18 +96,400 @@ void ExchangePotentialD2::clearBank() {
     YBank.clear();
 }
 
+/** @brief Test if a given contribution has been precomputed
+ *
+ * @param[in] phi_p orbital for which the check is performed
+ *
+ * If the given contribution has been precomputed, it is simply copied,
+ * without additional recalculation.
+ */
+int ExchangePotentialD2::testInternal(Orbital phi_p) const {
+    const OrbitalVector &Phi = *this->orbitals;
+    const OrbitalVector &Kphi = this->exchange;
+
+    int out = -1;
+    if (Kphi.size() == Phi.size()) {
+        for (int i = 0; i < Phi.size(); i++) {
+            if (&Phi[i].real() == &phi_p.real() and &Phi[i].imag() == &phi_p.imag()) {
+                out = i;
+                break;
+            }
+        }
+    }
+    return out;
+}
+
+/** @brief Clears the precomputed exchange
+ *
+ * The pair potentials of the unperturbed orbitals are kept,
+ * since they can be reused in the next setup.
+ */
+void ExchangePotentialD2::clearInternal() {
+    this->exchange.clear();
+    this->exchange_dagger.clear();
+}
+
+/** @brief Fetch orbital i, either the local one or a copy from the bank */
+Orbital ExchangePotentialD2::getOrbital(BankAccount &bank, OrbitalVector &Phi, int i) {
+    if (mpi::my_orb(Phi[i])) return Phi[i];
+    Orbital phi_i;
+    bank.get_orb(i, phi_i, 1);
+    return phi_i;
+}
+
+/** @brief Computes the pair potential P[phi_i^dag * phi_j]
+ *
+ *  \param[in] prec precision used in the multiplication and Poisson application
+ *  \param[in] phi_i orbital to be conjugated and multiplied by phi_j
+ *  \param[in] phi_j orbital to be multiplied by phi_i^dag
+ *  \param[out] V_ij result, left empty if the product is negligible
+ *
+ * Same precision and screening as in calcExchange_kij, negligible pairs
+ * should be skipped by the caller with isNegligiblePair.
+ */
+void ExchangePotentialD2::calcPairPotential(double prec, Orbital phi_i, Orbital phi_j, Orbital &V_ij) {
+    mrcpp::ConvolutionOperator<3> &P = *this->poisson;
+
+    Orbital rho_ij = phi_i.paramCopy();
+    qmfunction::multiply(rho_ij, phi_i.dagger(), phi_j, prec / 10, true, true);
+    if (rho_ij.norm() < prec) return;
+
+    // the pair potential will be multiplied by the perturbed orbitals,
+    // which have roughly the support of the unperturbed ones
+    mrcpp::FunctionTreeVector<3> phi_opt_vec;
+    if (phi_i.hasReal()) phi_opt_vec.push_back(std::make_tuple(1.0, &phi_i.real()));
+    if (phi_i.hasImag()) phi_opt_vec.push_back(std::make_tuple(1.0, &phi_i.imag()));
+    if (phi_j.hasReal() and &phi_j.real() != &phi_i.real()) phi_opt_vec.push_back(std::make_tuple(1.0, &phi_j.real()));
+    if (phi_j.hasImag() and &phi_j.imag() != &phi_i.imag()) phi_opt_vec.push_back(std::make_tuple(1.0, &phi_j.imag()));
+
+    if (rho_ij.hasReal()) {
+        V_ij.alloc(NUMBER::Real);
+        mrcpp::apply(prec * 10, V_ij.real(), P, rho_ij.real(), phi_opt_vec, -1, true);
+    }
+    if (rho_ij.hasImag()) {
+        V_ij.alloc(NUMBER::Imag);
+        mrcpp::apply(prec * 10, V_ij.imag(), P, rho_ij.imag(), phi_opt_vec, -1, true);
+    }
+}
+
+/** @brief Computes the pair potentials of the unperturbed orbitals
+ *
+ *  @param[in] prec precision used in the construction
+ *
+ * Only pairs i <= j are computed. The pairs are divided into square blocks
+ * which are distributed dynamically among the ranks, such that each orbital
+ * is fetched only once per block. The results are stored in the bank.
+ */
+void ExchangePotentialD2::setupPairs(double prec) {
+    Timer timer;
+    OrbitalVector &Phi = *this->orbitals;
+    int N = Phi.size();
+    clearPairs();
+    this->pairs->prec = prec;
+    this->pairs->norms = DoubleVector::Zero(N * N);
+    if (bank_size < 1) this->pairs->potentials = OrbitalVector(N * N);
+
+    int block_size = std::min(16, std::max(2, static_cast<int>(std::sqrt(N * N / (14 * orb_size)))));
+    int nblocks = (N + block_size - 1) / block_size;
+    std::vector<std::pair<int, int>> tasks;
+    for (int jb = 0; jb < nblocks; jb++) {
+        for (int ib = 0; ib <= jb; ib++) tasks.push_back(std::make_pair(ib, jb));
+    }
+
+    TaskManager tasksMaster(tasks.size());
+    while (true) {
+        int task = tasksMaster.next_task();
+        if (task < 0) break;
+        int i0 = tasks[task].first * block_size;
+        int j0 = tasks[task].second * block_size;
+        int i1 = std::min(N, i0 + block_size);
+        int j1 = std::min(N, j0 + block_size);
+
+        OrbitalVector iorb_vec, jorb_vec;
+        for (int i = i0; i < i1; i++) iorb_vec.push_back(getOrbital(PhiBank, Phi, i));
+        for (int j = j0; j < j1; j++) jorb_vec.push_back(getOrbital(PhiBank, Phi, j));
+
+        for (int j = j0; j < j1; j++) {
+            for (int i = i0; i < i1 and i <= j; i++) {
+                Orbital &phi_i = iorb_vec[i - i0];
+                Orbital &phi_j = jorb_vec[j - j0];
+                if (isNegligiblePair(i, j, prec)) continue;
+                Orbital V_ij = phi_j.paramCopy();
+                calcPairPotential(prec, phi_i, phi_j, V_ij);
+                if (not(V_ij.hasReal() or V_ij.hasImag())) continue;
+                this->pairs->norms(i + j * N) = V_ij.norm();
+                putPairPotential(i, j, V_ij);
+            }
+        }
+        for (int i = i0; i < i1; i++) {
+            if (not mpi::my_orb(Phi[i])) iorb_vec[i - i0].free(NUMBER::Total);
+        }
+        for (int j = j0; j < j1; j++) {
+            if (not mpi::my_orb(Phi[j])) jorb_vec[j - j0].free(NUMBER::Total);
+        }
+    }
+    mpi::allreduce_vector(this->pairs->norms, mpi::comm_orb);
+    mrcpp::print::time(3, "Computing pair potentials", timer);
+}
+
+/** @brief Precomputes the exchange and its adjoint applied to the unperturbed orbitals
+ *
+ *  @param[in] prec precision used in the construction
+ *
+ * With the pair potentials V_ip = P[phi_i^dag phi_p] the contributions are
+ *
+ * K phi_p     = sum_i x_i V_ip + phi_i P[y_i^dag phi_p]
+ * K^dag phi_p = sum_i y_i V_ip + phi_i P[x_i^dag phi_p]
+ *
+ * so only the second terms need a Poisson application in each setup. For
+ * static perturbations (X = Y) the two are identical and computed once.
+ * The pair potentials are taken from the shared storage if they are already
+ * there at sufficient precision (see sharePairs), and computed otherwise.
+ *
+ * The work is divided into tasks of one block of i against one block of p,
+ * which are distributed dynamically among the ranks. The contributions to
+ * orbitals of other ranks are passed through the bank and added by their
+ * owners as they arrive, as in the ground state exchange.
+ */
+void ExchangePotentialD2::setupInternal(double prec) {
+    Timer timerT, t_calc(false), t_add(false), t_send(false), t_wait(false);
+    setApplyPrec(prec);
+    if (this->exchange.size() != 0) MSG_ERROR("Exchange not properly cleared");
+
+    OrbitalVector &Phi = *this->orbitals;
+    OrbitalVector &X = *this->orbitals_x;
+    OrbitalVector &Y = *this->orbitals_y;
+    int N = Phi.size();
+    // use fixed exchange_prec if set explicitly, otherwise use setup prec
+    double precf = (this->exchange_prec > 0.0) ? this->exchange_prec : prec;
+    prec = mpi::numerically_exact ? -1.0 : prec;
+    precf /= std::sqrt(1.0 * N);
+
+    // pair potentials are recomputed only if the precision is tightened
+    if (this->pairs->norms.size() != N * N or precf < this->pairs->prec) {
+        // N(N+1)/2 pair potentials of roughly orbital size, held by the bank if present
+        DoubleVector orb_kb = DoubleVector::Constant(1, orbital::get_size_nodes(Phi));
+        mpi::allreduce_vector(orb_kb, mpi::comm_orb);
+        if (not canStorePairs(orb_kb(0))) {
+            println(1, " Pair potentials exceed the memory limit: using on-the-fly exchange");
+            return;
+        }
+        setupPairs(precf);
+    } else {
+        println(3, " Reusing pair potentials of the unperturbed orbitals");
+    }
+
+    OrbitalVector &Ex = this->exchange;
+    OrbitalVector &Ex_dag = this->exchange_dagger;
+    for (auto &phi_p : Phi) {
+        Ex.push_back(phi_p.paramCopy());
+        if (not this->useOnlyX) Ex_dag.push_back(phi_p.paramCopy());
+    }
+
+    // tasks t = ib + pb * nblocks, each flagged to the owners of its p orbitals when done
+    int block_size = std::min(16, std::max(2, static_cast<int>(std::sqrt(N * N / (7 * orb_size)))));
+    int nblocks = (N + block_size - 1) / block_size;
+    int ntasks = nblocks * nblocks;
+    std::vector<std::vector<int>> towners(ntasks);
+    int n_pending = 0;
+    for (int t = 0; t < ntasks; t++) {
+        int p0 = (t / nblocks) * block_size;
+        std::set<int> owners;
+        for (int p = p0; p < std::min(N, p0 + block_size); p++) owners.insert(Phi[p].rankID());
+        for (int r : owners) {
+            if (r >= 0) towners[t].push_back(r);
+        }
+        if (owners.count(mpi::orb_rank) > 0) n_pending++;
+    }
+
+    BankAccount ExBank;
+    BankAccount ExDagBank;
+    TaskManager tasksMaster(ntasks);
+
+    // contributions from other ranks are added to the own orbitals as they arrive
+    auto accumulateOwn = [&]() {
+        int n_rcv = 0;
+        for (int p = 0; p < N; p++) {
+            if (not mpi::my_orb(Phi[p])) continue;
+            std::vector<int> tVec = tasksMaster.get_readytask(p, 1);
+            for (int t : tVec) {
+                Orbital ex_rcv;
+                if (not ExBank.get_orb_del(p + t * N, ex_rcv)) MSG_ERROR("My Exchange not found in Bank");
+                t_add.resume();
+                Ex[p].add(1.0, ex_rcv);
+                t_add.stop();
+                if (not this->useOnlyX) {
+                    Orbital ex_dag_rcv;
+                    if (not ExDagBank.get_orb_del(p + t * N, ex_dag_rcv)) MSG_ERROR("My Exchange not found in Bank");
+                    t_add.resume();
+                    Ex_dag[p].add(1.0, ex_dag_rcv);
+                    t_add.stop();
+                }
+                n_rcv++;
+            }
+            if (tVec.size() > 0) {
+                Ex[p].crop(prec);
+                if (not this->useOnlyX) Ex_dag[p].crop(prec);
+            }
+        }
+        return n_rcv;
+    };
+
+    while (true) {
+        int task = tasksMaster.next_task();
+        if (task < 0) break;
+        int i0 = (task % nblocks) * block_size;
+        int p0 = (task / nblocks) * block_size;
+        int i1 = std::min(N, i0 + block_size);
+        int p1 = std::min(N, p0 + block_size);
+
+        OrbitalVector phi_vec, x_vec, y_vec, p_vec;
+        for (int i = i0; i < i1; i++) {
+            phi_vec.push_back(getOrbital(PhiBank, Phi, i));
+            x_vec.push_back(getOrbital(XBank, X, i));
+            y_vec.push_back((this->useOnlyX) ? x_vec.back() : getOrbital(YBank, Y, i));
+        }
+        for (int p = p0; p < p1; p++) p_vec.push_back(getOrbital(PhiBank, Phi, p));
+
+        for (int p = p0; p < p1; p++) {
+            Orbital &phi_p = p_vec[p - p0];
+
+            QMFunctionVector func_vec, func_vec_dag;
+            std::vector<ComplexDouble> coef_vec, coef_vec_dag;
+            for (int i = i0; i < i1; i++) {
+                Orbital &phi_i = phi_vec[i - i0];
+                Orbital &x_i = x_vec[i - i0];
+                Orbital &y_i = y_vec[i - i0];
+
+                double spin_fac = getSpinFactor(phi_i, phi_p);
+                if (std::abs(spin_fac) < mrcpp::MachineZero) continue;
+                ComplexDouble coef = spin_fac / phi_i.squaredNorm();
+
+                t_calc.resume();
+                Orbital V_ip;
+                bool has_pair = (this->pairs->norms(std::min(i, p) + std::max(i, p) * N) > 0.0);
+                if (has_pair) V_ip = getPairPotential(i, p);
+
+                // x_i V_ip + phi_i P[y_i^dag phi_p]
+                if (has_pair) {
+                    Orbital ex_xip = phi_p.paramCopy();
+                    qmfunction::multiply(ex_xip, x_i, V_ip, precf / 100, true, true);
+                    func_vec.push_back(ex_xip);
+                    coef_vec.push_back(coef);
+                }
+                Orbital ex_iyp = phi_p.paramCopy();
+                calcExchange_kij(precf, phi_i, y_i, phi_p, ex_iyp);
+                func_vec.push_back(ex_iyp);
+                coef_vec.push_back(coef);
+
+                // y_i V_ip + phi_i P[x_i^dag phi_p]
+                if (not this->useOnlyX) {
+                    if (has_pair) {
+                        Orbital ex_yip = phi_p.paramCopy();
+                        qmfunction::multiply(ex_yip, y_i, V_ip, precf / 100, true, true);
+                        func_vec_dag.push_back(ex_yip);
+                        coef_vec_dag.push_back(coef);
+                    }
+                    Orbital ex_ixp = phi_p.paramCopy();
+                    calcExchange_kij(precf, phi_i, x_i, phi_p, ex_ixp);
+                    func_vec_dag.push_back(ex_ixp);
+                    coef_vec_dag.push_back(coef);
+                }
+                if (has_pair and bank_size > 0) V_ip.free(NUMBER::Total);
+                t_calc.stop();
+            }
+            if (func_vec.size() == 0) continue;
+
+            // sum the contributions from this block
+            t_add.resume();
+            Orbital ex_p = phi_p.paramCopy();
+            Eigen::Map<ComplexVector> coefs(coef_vec.data(), coef_vec.size());
+            qmfunction::linear_combination(ex_p, coefs, func_vec, prec);
+            Orbital ex_dag_p = phi_p.paramCopy();
+            if (not this->useOnlyX) {
+                Eigen::Map<ComplexVector> coefs_dag(coef_vec_dag.data(), coef_vec_dag.size());
+                qmfunction::linear_combination(ex_dag_p, coefs_dag, func_vec_dag, prec);
+            }
+            t_add.stop();
+
+            if (mpi::my_orb(Phi[p])) {
+                t_add.resume();
+                Ex[p].add(1.0, ex_p);
+                Ex[p].crop(prec);
+                if (not this->useOnlyX) {
+                    Ex_dag[p].add(1.0, ex_dag_p);
+                    Ex_dag[p].crop(prec);
+                }
+                t_add.stop();
+            } else {
+                t_send.resume();
+                ExBank.put_orb(p + task * N, ex_p);
+                if (not this->useOnlyX) ExDagBank.put_orb(p + task * N, ex_dag_p);
+                tasksMaster.put_readytask(p, task);
+                ex_p.free(NUMBER::Total);
+                ex_dag_p.free(NUMBER::Total);
+                t_send.stop();
+            }
+        }
+
+        for (int i = i0; i < i1; i++) {
+            if (mpi::my_orb(Phi[i])) continue;
+            phi_vec[i - i0].free(NUMBER::Total);
+            x_vec[i - i0].free(NUMBER::Total);
+            if (not this->useOnlyX) y_vec[i - i0].free(NUMBER::Total);
+        }
+        for (int p = p0; p < p1; p++) {
+            if (not mpi::my_orb(Phi[p])) p_vec[p - p0].free(NUMBER::Total);
+        }
+        for (int r : towners[task]) tasksMaster.put_readytask(N + r, task);
+        if (bank_size > 0) accumulateOwn();
+    }
+
+    // wait until the tasks involving the own orbitals are finished
+    t_wait.resume();
+    while (bank_size > 0) {
+        n_pending -= tasksMaster.get_readytask(N + mpi::orb_rank, 1).size();
+        int n_rcv = accumulateOwn();
+        if (n_pending <= 0) break;
+        if (n_rcv == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    t_wait.stop();
+    if (this->useOnlyX) Ex_dag = Ex;
+    mrcpp::print::time(4, "Time calculate exchanges", t_calc);
+    mrcpp::print::time(4, "Time add exchanges", t_add);
+    mrcpp::print::time(4, "Time send exchanges", t_send);
+    mrcpp::print::time(4, "Time wait others finished", t_wait);
+
+    IntVector sizes = IntVector::Zero(2 * N);
+    for (int p = 0; p < N; p++) {
+        if (not mpi::my_orb(Phi[p])) continue;
+        sizes[p] = Ex[p].getNNodes(NUMBER::Total);
+        sizes[p + N] = Ex[p].getSizeNodes(NUMBER::Total);
+    }
+    mpi::allreduce_vector(sizes, mpi::comm_orb);
+    auto t = timerT.elapsed();
+    int n = sizes.head(N).cast<long long>().sum() / N;
+    int m = sizes.tail(N).cast<long long>().sum() / N;
+    mrcpp::print::tree(2, "HF exchange (av.)", n, m, t);
+}
+
 /** @brief Apply exchange operator to given orbital
  *
  *  @param[in] phi_p input orbital
  *
- * The D2 operator has to be applied on-the-fly, e.i. no
- * pre-computed exchange contributions are available.
+ * Checks first if this particular exchange contribution has been
+ * precomputed, otherwise the operator is applied on-the-fly.
  */
 Orbital ExchangePotentialD2::apply(Orbital phi_p) {
     if (this->apply_prec < 0.0) {
         MSG_ERROR("Uninitialized operator");
         return phi_p.paramCopy();
     }
+    int p = testInternal(phi_p);
+    if (p >= 0) {
+        println(4, "Precomputed exchange");
+        return this->exchange[p];
+    }
 
     Timer timer;
     OrbitalVector &Phi = *this->orbitals;
@@ -117,6 +502,11 @@ Orbital ExchangePotentialD2::apply(Orbital phi_p) {
     // adjust precision since we sum over orbitals
     precf /= std::sqrt(1 * Phi.size());
 
+    // the pairs phi_i^dag * phi_p are screened against the cell norms of the internal orbitals
+    bool use_bound = (this->cell_norms.size() == Phi.size());
+    qmfunction::CellNormTable cells_p;
+    if (use_bound) cells_p = qmfunction::calc_cell_norms(phi_p);
+
     QMFunctionVector func_vec;
     std::vector<ComplexDouble> coef_vec;
     for (int i = 0; i < Phi.size(); i++) {
@@ -132,7 +522,9 @@ Orbital ExchangePotentialD2::apply(Orbital phi_p) {
         if (std::abs(spin_fac) >= mrcpp::MachineZero) {
             Orbital ex_xip = phi_p.paramCopy();
             Orbital ex_iyp = phi_p.paramCopy();
-            calcExchange_kij(precf, x_i, phi_i, phi_p, ex_xip);
+            if (not use_bound or qmfunction::calc_product_bound(this->cell_norms[i], cells_p) >= precf) {
+                calcExchange_kij(precf, x_i, phi_i, phi_p, ex_xip);
+            }
             calcExchange_kij(precf, phi_i, y_i, phi_p, ex_iyp);
             func_vec.push_back(ex_xip);
             func_vec.push_back(ex_iyp);
@@ -156,14 +548,19 @@ Orbital ExchangePotentialD2::apply(Orbital phi_p) {
  *
  *  @param[in] phi_p input orbital
  *
- * The D2 operator has to be applied on-the-fly, e.i. no
- * pre-computed exchange contributions are available.
+ * Checks first if this particular exchange contribution has been
+ * precomputed, otherwise the operator is applied on-the-fly.
  */
 Orbital ExchangePotentialD2::dagger(Orbital phi_p) {
     if (this->apply_prec < 0.0) {
         MSG_ERROR("Uninitialized operator");
         return phi_p.paramCopy();
     }
+    int p = testInternal(phi_p);
+    if (p >= 0) {
+        println(4, "Precomputed exchange");
+        return this->exchange_dagger[p];
+    }
 
     Timer timer;
     OrbitalVector &Phi = *this->orbitals;
@@ -176,6 +573,11 @@ Orbital ExchangePotentialD2::dagger(Orbital phi_p) {
     // adjust precision since we sum over orbitals
     precf /= std::min(10.0, std::sqrt(1.0 * Phi.size()));
 
+    // the pairs phi_i^dag * phi_p are screened against the cell norms of the internal orbitals
+    bool use_bound = (this->cell_norms.size() == Phi.size());
+    qmfunction::CellNormTable cells_p;
+    if (use_bound) cells_p = qmfunction::calc_cell_norms(phi_p);
+
     QMFunctionVector func_vec;
     std::vector<ComplexDouble> coef_vec;
     for (int i = 0; i < Phi.size(); i++) {
@@ -192,7 +594,9 @@ Orbital ExchangePotentialD2::dagger(Orbital phi_p) {
             Orbital ex_ixp = phi_p.paramCopy();
             Orbital ex_yip = phi_p.paramCopy();
             calcExchange_kij(precf, phi_i, x_i, phi_p, ex_ixp);
-            calcExchange_kij(precf, y_i, phi_i, phi_p, ex_yip);
+            if (not use_bound or qmfunction::calc_product_bound(this->cell_norms[i], cells_p) >= precf) {
+                calcExchange_kij(precf, y_i, phi_i, phi_p, ex_yip);
+            }
             func_vec.push_back(ex_ixp);
             func_vec.push_back(ex_yip);
             coef_vec.push_back(spin_fac / phi_i.squaredNorm());
@@ -42,17 +42,24 @@ namespace mrchem {
  * set of unperturbed orbitals. The OrbitalVector defining the
  * operator is fixed throughout the operator life time, but the
  * orbitals themselves are allowed to change in between each
- * application. The internal exchange potentials (the operator applied
- * to it's own orbitals) can be precomputed and stored for fast
- * retrieval. Option to use screening based on previous calculations
- * of the internal exchange (make sure that the internal orbitals
- * haven't been significantly changed since the last time the operator
- * was set up, e.g. through an orbital rotation).
+ * application. The internal exchange potentials (the operator and its
+ * adjoint applied to the unperturbed orbitals) can be precomputed and
+ * stored for fast retrieval. Option to use screening based on previous
+ * calculations of the internal exchange (make sure that the internal
+ * orbitals haven't been significantly changed since the last time the
+ * operator was set up, e.g. through an orbital rotation).
+ *
+ * The precomputation reuses the pair potentials P[phi_i^dag phi_j] of the
+ * unperturbed orbitals, which are fixed throughout the response calculation.
+ * They are computed once, exploiting the symmetry between (i,j) and (j,i),
+ * and kept in the bank. Through sharePairs they are taken from (and left in)
+ * the unperturbed exchange operator, such that all response calculations on
+ * the same ground state share them.
  */
 
 class ExchangePotentialD2 final : public ExchangePotential {
 public:
-    ExchangePotentialD2(std::shared_ptr<mrcpp::PoissonOperator> P,
+    ExchangePotentialD2(std::shared_ptr<mrcpp::ConvolutionOperator<3>> P,
                         std::shared_ptr<OrbitalVector> Phi,
                         std::shared_ptr<OrbitalVector> X,
                         std::shared_ptr<OrbitalVector> Y,
@@ -65,12 +72,20 @@ private:
     BankAccount PhiBank; // to put the Orbitals
     BankAccount XBank;
     BankAccount YBank;
-    bool useOnlyX;                             ///< true if X and Y are the same set of orbitals
+    bool useOnlyX{false};                      ///< true if X and Y are the same set of orbitals
+    OrbitalVector exchange_dagger;             ///< Precomputed adjoint exchange from the internal orbital set
     std::shared_ptr<OrbitalVector> orbitals_x; ///< first set of perturbed orbitals defining the exchange operator
     std::shared_ptr<OrbitalVector> orbitals_y; ///< second set of perturbed orbitals defining the exchange operator
 
     void setupBank() override;
     void clearBank();
+    int testInternal(Orbital phi_p) const override;
+    void setupInternal(double prec) override;
+    void clearInternal() override;
+
+    void setupPairs(double prec);
+    void calcPairPotential(double prec, Orbital phi_i, Orbital phi_j, Orbital &V_ij);
+    Orbital getOrbital(BankAccount &bank, OrbitalVector &Phi, int i);
 
     ComplexDouble evalf(const mrcpp::Coord<3> &r) const override { return 0.0; }
 
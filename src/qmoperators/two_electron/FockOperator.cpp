@@ -38,6 +38,7 @@
 #include "qmoperators/one_electron/ElectricFieldOperator.h"
 #include "qmoperators/one_electron/KineticOperator.h"
 #include "qmoperators/one_electron/NuclearOperator.h"
+#include "utils/ScopedTimer.h"
 #include "utils/math_utils.h"
 
 using mrcpp::Printer;
@@ -97,6 +98,13 @@ void FockOperator::build(double exx) {
     if (this->ext != nullptr) this->V += (*this->ext);
     if (this->Ro != nullptr) this->V -= (*this->Ro);
 
+    this->V_x = RankZeroOperator();
+    if (this->nuc != nullptr) this->V_x += (*this->nuc);
+    if (this->coul != nullptr) this->V_x += (*this->coul);
+    if (this->xc != nullptr) this->V_x += (*this->xc);
+    if (this->ext != nullptr) this->V_x += (*this->ext);
+    if (this->Ro != nullptr) this->V_x -= (*this->Ro);
+
     RankZeroOperator &F = (*this);
     F = this->kinetic() + this->potential();
 }
@@ -109,6 +117,7 @@ void FockOperator::build(double exx) {
  * it will compute the internal exchange if there is an ExchangeOperator.
  */
 void FockOperator::setup(double prec) {
+    ScopedTimer section("fock_setup");
     Timer t_tot;
     auto plevel = Printer::getPrintLevel();
     mrcpp::print::header(2, "Building Fock operator");
@@ -195,6 +204,7 @@ SCFEnergy FockOperator::trace(OrbitalVector &Phi, const Nuclei &nucs) {
 }
 
 ComplexMatrix FockOperator::operator()(OrbitalVector &bra, OrbitalVector &ket) {
+    ScopedTimer section("fock_matrix");
     Timer t_tot;
     auto plevel = Printer::getPrintLevel();
     mrcpp::print::header(2, "Computing Fock matrix");
@@ -205,7 +215,13 @@ ComplexMatrix FockOperator::operator()(OrbitalVector &bra, OrbitalVector &ket) {
     ComplexMatrix T = ComplexMatrix::Zero(bra.size(), ket.size());
     if (t != nullptr) T += qmoperator::calc_kinetic_matrix(*t, bra, ket);
 
+    // on-the-fly exchange among the defining orbitals is taken from the pair
+    // potentials, which avoids applying the exchange to the full orbital vector
     ComplexMatrix V = ComplexMatrix::Zero(bra.size(), ket.size());
+    if (this->ex != nullptr and &bra == &ket and this->ex->useInternalMatrix(ket)) {
+        v = this->V_x;
+        V -= this->exact_exchange * this->ex->getInternalMatrix();
+    }
     if (v.size() > 0) V += v(bra, ket);
 
     mrcpp::print::footer(2, t_tot, 2);
@@ -88,6 +88,7 @@ private:
     double exact_exchange{1.0};
     RankZeroOperator T;   ///< Total kinetic energy operator
     RankZeroOperator V;   ///< Total potential energy operator
+    RankZeroOperator V_x; ///< Potential energy operator without exact exchange
     RankZeroOperator H_1; ///< Perturbation operators
 
     std::shared_ptr<KineticOperator> kin;
@@ -31,6 +31,7 @@
 #include "qmfunctions/Orbital.h"
 #include "qmfunctions/density_utils.h"
 #include "qmfunctions/orbital_utils.h"
+#include "utils/ScopedTimer.h"
 
 using mrcpp::FunctionTree;
 using mrcpp::Printer;
@@ -54,6 +55,7 @@ namespace mrchem {
  *
  */
 void XCPotential::setup(double prec) {
+    ScopedTimer section("xc_setup");
     if (isSetup(prec)) return;
     setApplyPrec(prec);
     if (this->mrdft == nullptr) MSG_ERROR("XCFunctional not initialized");
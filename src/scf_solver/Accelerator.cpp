@@ -31,6 +31,7 @@
 #include "Accelerator.h"
 #include "qmfunctions/Orbital.h"
 #include "qmfunctions/orbital_utils.h"
+#include "utils/ScopedTimer.h"
 
 using mrcpp::Printer;
 using mrcpp::Timer;
@@ -202,6 +203,7 @@ void Accelerator::accelerate(double prec,
                              OrbitalVector &dPhi,
                              ComplexMatrix *F,
                              ComplexMatrix *dF) {
+    ScopedTimer section("kain");
     if (this->maxHistory < 1) return;
 
     Timer t_tot;
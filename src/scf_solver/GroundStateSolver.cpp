@@ -35,8 +35,10 @@
 #include "qmfunctions/orbital_utils.h"
 #include "qmfunctions/qmfunction_utils.h"
 #include "qmoperators/one_electron/KineticOperator.h"
+#include "qmoperators/two_electron/ExchangeOperator.h"
 #include "qmoperators/two_electron/FockOperator.h"
 #include "qmoperators/two_electron/ReactionOperator.h"
+#include "utils/ScopedTimer.h"
 
 using mrcpp::Printer;
 using mrcpp::Timer;
@@ -215,6 +217,7 @@ void GroundStateSolver::reset() {
  *
  */
 json GroundStateSolver::optimize(Molecule &mol, FockOperator &F) {
+    ScopedTimer section("optimize");
     printParameters("Optimize ground state orbitals");
     Timer t_tot;
     json json_out;
@@ -246,6 +249,7 @@ json GroundStateSolver::optimize(Molecule &mol, FockOperator &F) {
     json_out["cycles"] = {};
     while (nIter++ < this->maxIter or this->maxIter < 0) {
         json json_cycle;
+        auto t_snap = timings::snapshot();
         std::stringstream o_header;
         o_header << "SCF cycle " << nIter;
         mrcpp::print::header(1, o_header.str(), 0, '#');
@@ -311,6 +315,7 @@ json GroundStateSolver::optimize(Molecule &mol, FockOperator &F) {
         json_cycle["energy_terms"] = E_n.json();
         json_cycle["energy_total"] = E_n.getTotalEnergy();
         json_cycle["energy_update"] = err_p;
+        if (F.getExchangeOperator()) json_cycle["exchange_screening"] = F.getExchangeOperator()->getPairScreening();
 
         // Rotate orbitals
         if (needLocalization(nIter, converged)) {
@@ -333,9 +338,10 @@ json GroundStateSolver::optimize(Molecule &mol, FockOperator &F) {
         printResidual(err_t, converged);
         mrcpp::print::separator(2, '=', 2);
         printProperty();
-        printMemory();
+        printMemory(Phi_n);
         t_scf.stop();
         json_cycle["wall_time"] = t_scf.elapsed();
+        json_cycle["timings"] = timings::since(t_snap);
         mrcpp::print::footer(1, t_scf, 2, '#');
         mrcpp::print::separator(2, ' ', 2);
 
@@ -0,0 +1,159 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+
+#include <MRCPP/Printer>
+
+#include "HelmholtzCache.h"
+#include "mrchem.h"
+#include "utils/memory_utils.h"
+
+namespace mrchem {
+
+namespace {
+const double mu_step = 0.01;         ///< Grid step in log(mu), mu is reproduced within 0.5%
+const int prec_steps = 10;           ///< Grid points per decade of the build precision
+const double default_limit = 1000.0; ///< Memory limit (MB) of the cache without budget
+const int default_entries = 64;      ///< Max number of cached operators
+
+struct CacheEntry {
+    helmholtz_cache::Helmholtz_p oper;
+    double mb;
+    long last_used;
+};
+
+using CacheKey = std::tuple<const void *, long, long>;
+std::map<CacheKey, CacheEntry> oper_cache;
+double cache_mb = 0.0;
+double max_oper_mb = 0.0;
+int max_entries = default_entries;
+long n_requests = 0;
+
+long mu_index(double mu) {
+    return std::lround(std::log(mu) / mu_step);
+}
+
+long prec_index(double prec) {
+    return static_cast<long>(std::floor(std::log10(prec) * prec_steps + 1.0e-8));
+}
+
+double memory_limit() {
+    if (memory_utils::has_budget()) return 0.1 * memory_utils::get_budget();
+    return default_limit;
+}
+
+/** @brief Release least recently used operators until the cache is below its limits */
+void evict(const CacheKey &keep) {
+    auto over_limit = [] { return cache_mb > memory_limit() or static_cast<int>(oper_cache.size()) > max_entries; };
+    while (over_limit() and oper_cache.size() > 1) {
+        auto lru = oper_cache.end();
+        for (auto it = oper_cache.begin(); it != oper_cache.end(); ++it) {
+            if (it->first == keep) continue;
+            if (lru == oper_cache.end() or it->second.last_used < lru->second.last_used) lru = it;
+        }
+        if (lru == oper_cache.end()) break;
+        cache_mb -= lru->second.mb;
+        oper_cache.erase(lru);
+    }
+}
+} // namespace
+
+/** @brief Helmholtz parameter rounded to the grid used by the cache */
+double helmholtz_cache::quantize_mu(double mu) {
+    if (mu <= 0.0) MSG_ABORT("Invalid Helmholtz parameter");
+    return std::exp(mu_index(mu) * mu_step);
+}
+
+/** @brief Build precision rounded down to the grid used by the cache */
+double helmholtz_cache::quantize_prec(double prec) {
+    if (prec <= 0.0) MSG_ABORT("Invalid Helmholtz precision");
+    return std::pow(10.0, static_cast<double>(prec_index(prec)) / prec_steps);
+}
+
+/** @brief Helmholtz operator for the rounded mu and precision
+ *
+ * @param[in] mra MRA of the operator
+ * @param[in] mu Helmholtz parameter, the operator is built for quantize_mu(mu)
+ * @param[in] prec build precision, the operator is built for quantize_prec(prec)
+ *
+ * The memory of a new operator is estimated from the increase in resident memory
+ * during its construction. The allocator often reuses freed memory, in which case
+ * the increase is zero, and the largest operator measured so far is used instead.
+ * The number of cached operators is in any case capped by set_max_entries.
+ */
+helmholtz_cache::Helmholtz_p helmholtz_cache::get(const mrcpp::MultiResolutionAnalysis<3> &mra, double mu, double prec) {
+    if (mu <= 0.0) MSG_ABORT("Invalid Helmholtz parameter");
+    if (prec <= 0.0) MSG_ABORT("Invalid Helmholtz precision");
+    auto key = std::make_tuple(static_cast<const void *>(&mra), mu_index(mu), prec_index(prec));
+    n_requests++;
+
+    auto it = oper_cache.find(key);
+    if (it != oper_cache.end()) {
+        it->second.last_used = n_requests;
+        return it->second.oper;
+    }
+
+    double mem_start = memory_utils::get_usage();
+    auto oper = std::make_shared<mrcpp::HelmholtzOperator>(mra, quantize_mu(mu), quantize_prec(prec));
+    double mb = std::max(memory_utils::get_usage() - mem_start, 0.0);
+    if (mb > 0.0) max_oper_mb = std::max(max_oper_mb, mb);
+    if (mb <= 0.0) mb = max_oper_mb;
+    println(3, " Helmholtz operator built  mu = " << quantize_mu(mu) << "  prec = " << quantize_prec(prec));
+
+    oper_cache[key] = CacheEntry{oper, mb, n_requests};
+    cache_mb += mb;
+    evict(key);
+    return oper;
+}
+
+/** @brief Set the max number of cached operators (default 64), evicting as needed */
+void helmholtz_cache::set_max_entries(int n) {
+    if (n < 1) MSG_ABORT("Invalid Helmholtz cache size");
+    max_entries = n;
+    if (static_cast<int>(oper_cache.size()) > max_entries) {
+        auto newest = oper_cache.begin();
+        for (auto it = oper_cache.begin(); it != oper_cache.end(); ++it) {
+            if (it->second.last_used > newest->second.last_used) newest = it;
+        }
+        evict(newest->first);
+    }
+}
+
+/** @brief Number of operators currently in the cache */
+int helmholtz_cache::size() {
+    return oper_cache.size();
+}
+
+/** @brief Release all cached operators (operators still in use are kept alive by their owners) */
+void helmholtz_cache::clear() {
+    oper_cache.clear();
+    cache_mb = 0.0;
+}
+
+} // namespace mrchem
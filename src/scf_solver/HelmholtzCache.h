@@ -0,0 +1,63 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+#pragma once
+
+#include <memory>
+
+#include <MRCPP/MWOperators>
+
+/** @file HelmholtzCache.h
+ *
+ * @brief Reuse of Helmholtz operators across orbitals and iterations
+ *
+ * The Helmholtz parameter mu is rounded to a logarithmic grid, and the build
+ * precision is rounded down to a logarithmic grid, such that operators for
+ * nearly degenerate orbitals, and for the same orbital in consecutive
+ * iterations, are shared. The solvers use the rounded mu also in the shift
+ * lambda = -mu^2/2 of the SCF equations, so the rounding does not change the
+ * converged solution, only (marginally) the rate of convergence.
+ *
+ * The least recently used operators are released when the estimated memory
+ * of the cache exceeds its limit, which is a fraction of the memory budget if
+ * one is given, or when the number of operators exceeds its cap. Operators that are still in use are kept alive by their users.
+ */
+
+namespace mrchem {
+namespace helmholtz_cache {
+
+using Helmholtz_p = std::shared_ptr<mrcpp::HelmholtzOperator>;
+
+double quantize_mu(double mu);
+double quantize_prec(double prec);
+
+Helmholtz_p get(const mrcpp::MultiResolutionAnalysis<3> &mra, double mu, double prec);
+
+void set_max_entries(int n);
+int size();
+void clear();
+
+} // namespace helmholtz_cache
+} // namespace mrchem
@@ -23,17 +23,24 @@
  * <https://mrchem.readthedocs.io/>
  */
 
+#include <map>
+
 #include "MRCPP/MWOperators"
 #include "MRCPP/Printer"
 #include "MRCPP/Timer"
+#include "MRCPP/treebuilders/ConvolutionCalculator.h"
+#include "MRCPP/treebuilders/TreeBuilder.h"
+#include "MRCPP/treebuilders/WaveletAdaptor.h"
 
 #include "parallel.h"
 
+#include "HelmholtzCache.h"
 #include "HelmholtzVector.h"
 #include "qmfunctions/Orbital.h"
 #include "qmfunctions/orbital_utils.h"
 #include "qmfunctions/qmfunction_utils.h"
 #include "tensor/RankZeroOperator.h"
+#include "utils/ScopedTimer.h"
 #include "utils/print_utils.h"
 
 using mrcpp::Printer;
@@ -42,18 +49,39 @@ using mrcpp::Timer;
 namespace mrchem {
 extern mrcpp::MultiResolutionAnalysis<3> *MRA; // Global MRA
 
+namespace {
+/** Same as mrcpp::apply with absolute precision, except that the band widths of the
+ *  operator are not computed (and cleared) here, but once by the caller for the batch */
+void apply_batched(double prec, mrcpp::FunctionTree<3> &out, mrcpp::ConvolutionOperator<3> &oper, mrcpp::FunctionTree<3> &inp) {
+    mrcpp::WaveletAdaptor<3> adaptor(prec, out.getMRA().getMaxScale(), true);
+    mrcpp::ConvolutionCalculator<3> calculator(prec, oper, inp);
+    mrcpp::TreeBuilder<3> builder;
+    builder.build(out, calculator, adaptor, -1);
+    out.mwTransform(mrcpp::TopDown, false); // add coarse scale contributions
+    out.mwTransform(mrcpp::BottomUp);
+    out.calcSquareNorm();
+    inp.deleteGenerated();
+}
+} // namespace
+
 /** @brief HelmholtzVector constructor
  *
  * This will set the build precision of the Helmholtz operators and the vector
  * of lambda parameters that will be used in the subsequent application. No
- * operators are constructed at this point, they are produced on-the-fly in
- * the application.
+ * operators are constructed at this point, they are taken from the operator
+ * cache in the application.
+ *
+ * The lambda parameters are rounded to the mu grid of the cache. The rounded
+ * values are also returned in the lambda matrix, so the solvers use the same
+ * shift as the operators and the solution is unaffected by the rounding.
  */
 HelmholtzVector::HelmholtzVector(double pr, const DoubleVector &l)
         : prec(pr) {
     this->lambda = l;
     for (int i = 0; i < this->lambda.size(); i++) {
         if (this->lambda(i) > 0.0) this->lambda(i) = -0.5;
+        double mu_i = helmholtz_cache::quantize_mu(std::sqrt(-2.0 * this->lambda(i)));
+        this->lambda(i) = -0.5 * mu_i * mu_i;
     }
 }
 
@@ -69,23 +97,27 @@ HelmholtzVector::HelmholtzVector(double pr, const DoubleVector &l)
  *      local orbitals are computed.
  */
 OrbitalVector HelmholtzVector::operator()(OrbitalVector &Phi) const {
+    ScopedTimer section("helmholtz");
     Timer t_tot, t_lap;
     auto plevel = Printer::getPrintLevel();
     mrcpp::print::header(2, "Applying Helmholtz operators");
 
     int pprec = Printer::getPrecision();
     OrbitalVector out = orbital::param_copy(Phi);
-    for (int i = 0; i < Phi.size(); i++) {
-        if (not mpi::my_orb(out[i])) continue;
-
-        t_lap.start();
-        out[i] = apply(i, Phi[i]);
-        out[i].rescale(-1.0 / (2.0 * MATHCONST::pi));
-
-        std::stringstream o_txt;
-        o_txt << std::setw(4) << i;
-        o_txt << std::setw(19) << std::setprecision(pprec) << std::scientific << out[i].norm();
-        print_utils::qmfunction(2, o_txt.str(), out[i], t_lap);
+    for (auto &group : groupOrbitals(Phi)) {
+        auto H_p = getOperator(group.front());
+        H_p->calcBandWidths(this->prec);
+        for (auto i : group) {
+            t_lap.start();
+            out[i] = apply(*H_p, Phi[i]);
+            out[i].rescale(-1.0 / (2.0 * MATHCONST::pi));
+
+            std::stringstream o_txt;
+            o_txt << std::setw(4) << i;
+            o_txt << std::setw(19) << std::setprecision(pprec) << std::scientific << out[i].norm();
+            print_utils::qmfunction(2, o_txt.str(), out[i], t_lap);
+        }
+        H_p->clearBandWidths();
     }
     mrcpp::print::footer(2, t_tot, 2);
     if (plevel == 1) mrcpp::print::time(1, "Applying Helmholtz operators", t_tot);
@@ -108,6 +140,7 @@ OrbitalVector HelmholtzVector::operator()(OrbitalVector &Phi) const {
  *      local orbitals are computed.
  */
 OrbitalVector HelmholtzVector::apply(RankZeroOperator &V, OrbitalVector &Phi, OrbitalVector &Psi) const {
+    ScopedTimer section("helmholtz");
     Timer t_tot, t_lap;
     auto pprec = Printer::getPrecision();
     auto plevel = Printer::getPrintLevel();
@@ -115,45 +148,75 @@ OrbitalVector HelmholtzVector::apply(RankZeroOperator &V, OrbitalVector &Phi, Or
     if (Phi.size() != Psi.size()) MSG_ABORT("OrbitalVector size mismatch");
 
     OrbitalVector out = orbital::param_copy(Phi);
-    for (int i = 0; i < Phi.size(); i++) {
-        if (not mpi::my_orb(out[i])) continue;
-
-        t_lap.start();
-        Orbital Vphi_i = V(Phi[i]);
-        Vphi_i.add(1.0, Psi[i]);
-        Vphi_i.rescale(-1.0 / (2.0 * MATHCONST::pi));
-        out[i] = apply(i, Vphi_i);
-
-        std::stringstream o_txt;
-        o_txt << std::setw(4) << i;
-        o_txt << std::setw(19) << std::setprecision(pprec) << std::scientific << out[i].norm();
-        print_utils::qmfunction(2, o_txt.str(), out[i], t_lap);
+    for (auto &group : groupOrbitals(Phi)) {
+        auto H_p = getOperator(group.front());
+        H_p->calcBandWidths(this->prec);
+        for (auto i : group) {
+            t_lap.start();
+            Orbital Vphi_i = V(Phi[i]);
+            Vphi_i.add(1.0, Psi[i]);
+            Vphi_i.rescale(-1.0 / (2.0 * MATHCONST::pi));
+            out[i] = apply(*H_p, Vphi_i);
+
+            std::stringstream o_txt;
+            o_txt << std::setw(4) << i;
+            o_txt << std::setw(19) << std::setprecision(pprec) << std::scientific << out[i].norm();
+            print_utils::qmfunction(2, o_txt.str(), out[i], t_lap);
+        }
+        H_p->clearBandWidths();
     }
     mrcpp::print::footer(2, t_tot, 2);
     if (plevel == 1) mrcpp::print::time(1, "Applying Helmholtz operators", t_tot);
     return out;
 }
 
-/** @brief Apply Helmholtz operator on individual Orbital
- *
- * This will construct a Helmholtz operator with the i-th component of the
- * lambda vector and apply it to the input orbital.
+/** @brief Group the local orbitals that share the same Helmholtz operator
  *
- * Computes output as: out_i = H_i[phi_i]
+ * The cache builds its operators for the quantized mu = sqrt(-2*lambda), so all
+ * orbitals with the same quantized mu share one operator. Each group is applied as one batch: the operator
+ * is fetched from the cache once, and its band widths, which mrcpp::apply would
+ * recompute for every real and imaginary part, are computed once for the group.
+ * The groups are ordered by their first orbital.
  */
-Orbital HelmholtzVector::apply(int i, Orbital &phi) const {
+std::vector<std::vector<int>> HelmholtzVector::groupOrbitals(OrbitalVector &Phi) const {
+    if (Phi.size() != this->lambda.size()) MSG_ABORT("OrbitalVector size mismatch");
+    std::vector<std::vector<int>> groups;
+    std::map<double, int> group_idx;
+    for (int i = 0; i < Phi.size(); i++) {
+        if (not mpi::my_orb(Phi[i])) continue;
+        int n_groups = groups.size();
+        double key = this->lambda(i);
+        if (key < 0.0) key = helmholtz_cache::quantize_mu(std::sqrt(-2.0 * key)); // else aborts in getOperator
+        auto it = group_idx.insert({key, n_groups}).first;
+        if (it->second == n_groups) groups.push_back(std::vector<int>());
+        groups[it->second].push_back(i);
+    }
+    if (groups.size() > 0) println(3, " Helmholtz operators applied in " << groups.size() << " batches");
+    return groups;
+}
+
+/** @brief Helmholtz operator for the i-th component of the lambda vector */
+std::shared_ptr<mrcpp::HelmholtzOperator> HelmholtzVector::getOperator(int i) const {
     ComplexDouble mu_i = std::sqrt(-2.0 * this->lambda(i));
     if (std::abs(mu_i.imag()) > mrcpp::MachineZero) MSG_ABORT("Mu cannot be complex");
-    mrcpp::HelmholtzOperator H(*MRA, mu_i.real(), this->prec);
+    return helmholtz_cache::get(*MRA, mu_i.real(), this->prec);
+}
 
+/** @brief Apply Helmholtz operator on individual Orbital
+ *
+ * The band widths of H must be computed by the caller for the batch.
+ *
+ * Computes output as: out_i = H[phi_i]
+ */
+Orbital HelmholtzVector::apply(mrcpp::HelmholtzOperator &H, Orbital &phi) const {
     Orbital out = phi.paramCopy();
     if (phi.hasReal()) {
         out.alloc(NUMBER::Real);
-        mrcpp::apply(this->prec, out.real(), H, phi.real(), -1, true); // Absolute prec
+        apply_batched(this->prec, out.real(), H, phi.real()); // Absolute prec
     }
     if (phi.hasImag()) {
         out.alloc(NUMBER::Imag);
-        mrcpp::apply(this->prec, out.imag(), H, phi.imag(), -1, true); // Absolute prec
+        apply_batched(this->prec, out.imag(), H, phi.imag()); // Absolute prec
         if (phi.conjugate()) out.imag().rescale(-1.0);
     }
     return out;
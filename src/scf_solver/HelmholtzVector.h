@@ -25,6 +25,11 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
+
+#include <MRCPP/MWOperators>
+
 #include "mrchem.h"
 #include "qmfunctions/qmfunction_fwd.h"
 #include "tensor/tensor_fwd.h"
@@ -34,7 +39,9 @@
  * @brief Container of HelmholtzOperators for a corresponding OrbtialVector
  *
  * This class assigns one HelmholtzOperator to each orbital in an OrbitalVector.
- * The operators are produced on the fly based on a vector of lambda parameters.
+ * The operators are taken from the Helmholtz operator cache based on a vector of
+ * lambda parameters. The orbitals sharing the same operator are applied as a
+ * batch, with the operator fetched and its band widths computed once per batch.
  */
 
 namespace mrchem {
@@ -52,7 +59,9 @@ private:
     double prec;         ///< Precision for construction and application of Helmholtz operators
     DoubleVector lambda; ///< Helmholtz parameter, mu_i = sqrt(-2.0*lambda_i)
 
-    Orbital apply(int i, Orbital &phi) const;
+    std::vector<std::vector<int>> groupOrbitals(OrbitalVector &Phi) const;
+    std::shared_ptr<mrcpp::HelmholtzOperator> getOperator(int i) const;
+    Orbital apply(mrcpp::HelmholtzOperator &H, Orbital &phi) const;
 };
 
 } // namespace mrchem
@@ -34,6 +34,7 @@
 #include "qmfunctions/Orbital.h"
 #include "qmfunctions/orbital_utils.h"
 #include "qmoperators/two_electron/FockOperator.h"
+#include "utils/ScopedTimer.h"
 #include "utils/print_utils.h"
 
 using mrcpp::Printer;
@@ -61,6 +62,7 @@ namespace mrchem {
  *
  */
 json LinearResponseSolver::optimize(double omega, Molecule &mol, FockOperator &F_0, FockOperator &F_1) {
+    ScopedTimer section("optimize");
     printParameters(omega, F_1.perturbation().name());
     Timer t_tot;
     json json_out;
@@ -104,6 +106,7 @@ json LinearResponseSolver::optimize(double omega, Molecule &mol, FockOperator &F
     json_out["cycles"] = {};
     while (nIter++ < this->maxIter or this->maxIter < 0) {
         json json_cycle;
+        auto t_snap = timings::snapshot();
         std::stringstream o_header;
         o_header << "SCF cycle " << nIter;
         mrcpp::print::header(1, o_header.str(), 0, '#');
@@ -250,9 +253,13 @@ json LinearResponseSolver::optimize(double omega, Molecule &mol, FockOperator &F
         printResidual(err_t, converged);
         mrcpp::print::separator(2, '=', 2);
         printProperty();
-        printMemory();
+        OrbitalVector Phi_all = Phi_0;
+        Phi_all.insert(Phi_all.end(), X_n.begin(), X_n.end());
+        if (dynamic) Phi_all.insert(Phi_all.end(), Y_n.begin(), Y_n.end());
+        printMemory(Phi_all);
         t_scf.stop();
         json_cycle["wall_time"] = t_scf.elapsed();
+        json_cycle["timings"] = timings::since(t_snap);
         mrcpp::print::footer(1, t_scf, 2, '#');
         mrcpp::print::separator(2, ' ', 2);
 
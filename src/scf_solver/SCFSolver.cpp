@@ -31,6 +31,7 @@
 
 #include "qmfunctions/Orbital.h"
 #include "qmfunctions/orbital_utils.h"
+#include "utils/memory_utils.h"
 
 using mrcpp::Printer;
 using mrcpp::Timer;
@@ -290,11 +291,24 @@ void SCFSolver::printConvergence(bool converged, const std::string &txt) const {
     mrcpp::print::separator(0, '=', 2);
 }
 
-void SCFSolver::printMemory() const {
+/** @brief Print memory usage and record the memory high-water marks
+ *
+ * @param Phi: orbitals currently held by the solver
+ *
+ * The memory of the orbital function trees and of the bank is recorded for
+ * the memory report in the output. This is a collective operation.
+ */
+void SCFSolver::printMemory(const OrbitalVector &Phi) const {
     DoubleVector mem_vec = DoubleVector::Zero(mpi::orb_size);
     mem_vec(mpi::orb_rank) = static_cast<double>(mrcpp::details::get_memory_usage());
     mpi::allreduce_vector(mem_vec, mpi::comm_orb);
 
+    DoubleVector bank_vec = DoubleVector::Zero(1);
+    if (mpi::bank_size > 0 and mpi::grand_master()) bank_vec(0) = static_cast<double>(dataBank.get_maxtotalsize());
+    mpi::allreduce_vector(bank_vec, mpi::comm_orb);
+    memory_utils::record("orbitals", orbital::get_size_nodes(Phi) / 1024.0);
+    memory_utils::record("bank", bank_vec(0));
+
     std::string mem_unit = "(kB)";
     if (mem_vec.maxCoeff() > 512.0) {
         mem_vec.array() /= 1024.0;
@@ -314,12 +328,14 @@ void SCFSolver::printMemory() const {
     mrcpp::print::value(2, "Average memory process", mem_vec.mean(), mem_unit, 2, false);
     if (mpi::bank_size > 0 and mpi::grand_master()) {
         if (mem_unit == "(GB)") {
-            mrcpp::print::value(
-                1, "Maximum data in bank", (double)dataBank.get_maxtotalsize() / 1024, mem_unit, 2, false);
+            mrcpp::print::value(1, "Maximum data in bank", bank_vec(0) / 1024, mem_unit, 2, false);
         } else {
-            mrcpp::print::value(1, "Maximum data in bank", (double)dataBank.get_maxtotalsize(), "(MB)", 2, false);
+            mrcpp::print::value(1, "Maximum data in bank", bank_vec(0), "(MB)", 2, false);
         }
     }
+    if (memory_utils::has_budget()) {
+        mrcpp::print::value(2, "Memory budget process", memory_utils::get_budget(), "(MB)", 2, false);
+    }
     mrcpp::print::separator(2, '=', 2);
 }
 
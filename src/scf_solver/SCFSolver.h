@@ -87,7 +87,7 @@ protected:
                        int flag,
                        bool print_head = true) const;
     void printResidual(double residual, bool converged) const;
-    void printMemory() const;
+    void printMemory(const OrbitalVector &Phi) const;
 };
 
 } // namespace mrchem
@@ -33,6 +33,7 @@
 #include "qmfunctions/Orbital.h"
 #include "qmfunctions/orbital_utils.h"
 #include "qmfunctions/qmfunction_utils.h"
+#include "utils/memory_utils.h"
 #include "utils/print_utils.h"
 
 using QMOperator_p = std::shared_ptr<mrchem::QMOperator>;
@@ -337,15 +338,36 @@ ComplexDouble RankZeroOperator::dagger(Orbital bra, Orbital ket) {
  * ket vector, then computes the corresponding expectation matrix. Finally, the
  * expectation matrices are added up with the corresponding coefficient to yield
  * the final result.
+ *
+ * If a memory budget is set and O|ket> is not expected to fit within it, the
+ * ket vector is processed in chunks, and only the O|ket> of a single chunk is
+ * kept in memory at any time. The chunk size is estimated from the size of
+ * the ket orbitals, assuming that O|ket_j> is at most twice as large as ket_j.
  */
 ComplexMatrix RankZeroOperator::operator()(OrbitalVector &bra, OrbitalVector &ket) {
     Timer t1;
     RankZeroOperator &O = *this;
-    OrbitalVector Oket = O(ket);
-    ComplexMatrix out = orbital::calc_overlap_matrix(bra, Oket);
+
+    int N = ket.size();
+    double mem_per_orb = (N > 0) ? 2.0 * orbital::get_size_nodes(ket) / (1024.0 * N) : 0.0;
+    int chunk_size = memory_utils::get_chunk_size(N, mem_per_orb, mpi::comm_orb);
+
+    int n_nodes = 0;
+    int s_nodes = 0;
+    ComplexMatrix out = ComplexMatrix::Zero(bra.size(), N);
+    for (int j = 0; j < N; j += chunk_size) {
+        int n_j = std::min(chunk_size, N - j);
+        OrbitalVector ket_j(ket.begin() + j, ket.begin() + j + n_j);
+        OrbitalVector Oket_j = O(ket_j);
+        out.block(0, j, bra.size(), n_j) = orbital::calc_overlap_matrix(bra, Oket_j);
+        n_nodes += orbital::get_n_nodes(Oket_j);
+        s_nodes += orbital::get_size_nodes(Oket_j);
+    }
+    if (chunk_size < N) println(2, " Memory budget: applying " << O.name() << " in chunks of " << chunk_size);
+
     std::stringstream o_name;
     o_name << "<i|" << O.name() << "|j>";
-    mrcpp::print::tree(2, o_name.str(), orbital::get_n_nodes(Oket), orbital::get_size_nodes(Oket), t1.elapsed());
+    mrcpp::print::tree(2, o_name.str(), n_nodes, s_nodes, t1.elapsed());
     return out;
 }
 
@@ -0,0 +1,395 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include <Eigen/Dense>
+#include <MRCPP/Printer>
+#include <MRCPP/trees/FunctionNode.h>
+
+#include "GridPlotter.h"
+
+#include "chemistry/Molecule.h"
+#include "parallel.h"
+#include "qmfunctions/QMFunction.h"
+
+namespace mrchem {
+
+namespace {
+// Upper limit for the number of grid points kept in memory at once
+const long long max_block_points = 1LL << 22;
+// Fixed field widths of the text formats
+const int cube_width = 13;
+const int line_width = 15;
+} // namespace
+
+GridPlotter::GridPlotter(const Molecule &mol, const mrcpp::Coord<3> &o)
+        : molecule(&mol)
+        , O(o) {
+    this->vecs[0] = {1.0, 0.0, 0.0};
+    this->vecs[1] = {0.0, 1.0, 0.0};
+    this->vecs[2] = {0.0, 0.0, 1.0};
+}
+
+void GridPlotter::setRange(const mrcpp::Coord<3> &a, const mrcpp::Coord<3> &b, const mrcpp::Coord<3> &c) {
+    this->vecs[0] = a;
+    this->vecs[1] = b;
+    this->vecs[2] = c;
+}
+
+void GridPlotter::setFormat(const std::string &fmt) {
+    if (fmt == "text") {
+        this->binary = false;
+    } else if (fmt == "binary") {
+        this->binary = true;
+    } else {
+        MSG_ERROR("Invalid plot format: " << fmt);
+    }
+}
+
+void GridPlotter::linePlot(const std::array<int, 1> &npts, QMFunction &func, const std::string &fname, bool collective) {
+    std::array<int, 3> pts{npts[0], 1, 1};
+    if (func.hasReal()) plot(1, pts, func.real(), fname + "_re.line", collective);
+    if (func.hasImag()) plot(1, pts, func.imag(), fname + "_im.line", collective);
+}
+
+void GridPlotter::surfPlot(const std::array<int, 2> &npts, QMFunction &func, const std::string &fname, bool collective) {
+    std::array<int, 3> pts{npts[0], npts[1], 1};
+    if (func.hasReal()) plot(2, pts, func.real(), fname + "_re.surf", collective);
+    if (func.hasImag()) plot(2, pts, func.imag(), fname + "_im.surf", collective);
+}
+
+void GridPlotter::cubePlot(const std::array<int, 3> &npts, QMFunction &func, const std::string &fname, bool collective) {
+    auto ext = (this->binary) ? std::string(".bcube") : std::string(".cube");
+    if (func.hasReal()) plot(3, npts, func.real(), fname + "_re" + ext, collective);
+    if (func.hasImag()) plot(3, npts, func.imag(), fname + "_im" + ext, collective);
+}
+
+/** @brief Evaluate a function on the grid and write it to file
+ *
+ * @param[in] dim: Grid dimension (1: line, 2: surf, 3: cube)
+ * @param[in] npts: Number of points in each direction (1 for unused directions)
+ * @param[in] tree: Function to plot
+ * @param[in] fname: Name of output file
+ * @param[in] collective: Split the grid among the ranks of comm_orb
+ *
+ * The grid is processed in blocks of planes along the first direction. In the
+ * collective case every rank in comm_orb must call this function, and they all
+ * need the full function tree.
+ */
+void GridPlotter::plot(int dim, const std::array<int, 3> &npts, mrcpp::FunctionTree<3> &tree, const std::string &fname, bool collective) {
+    bool parallel = (collective and mpi::orb_size > 1);
+    int rank = (parallel) ? mpi::orb_rank : 0;
+    int size = (parallel) ? mpi::orb_size : 1;
+
+    auto nodes = setupNodes(tree, npts);
+    auto header = (dim == 3) ? cubeHeader(npts) : std::string();
+    auto plane_bytes = planeBytes(dim, npts);
+    auto total_bytes = static_cast<long long>(header.size()) + npts[0] * plane_bytes;
+
+    // Contiguous planes for each rank
+    int p_start = (rank * npts[0]) / size;
+    int p_end = ((rank + 1) * npts[0]) / size;
+    long long plane_points = static_cast<long long>(npts[1]) * npts[2];
+    int block_size = static_cast<int>(std::max(1LL, max_block_points / plane_points));
+
+#ifdef MRCHEM_HAS_MPI
+    MPI_File fh;
+    if (parallel) {
+        int err = MPI_File_open(mpi::comm_orb, fname.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+        if (err != MPI_SUCCESS) MSG_ABORT("Unable to open file: " << fname);
+        MPI_File_set_size(fh, static_cast<MPI_Offset>(total_bytes));
+    }
+#endif
+    std::ofstream fout;
+    if (not parallel) {
+        fout.open(fname, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (not fout) MSG_ABORT("Unable to open file: " << fname);
+    }
+
+    auto write_at = [&](long long offset, const char *data, long long count) {
+        if (count < 1) return;
+        if (parallel) {
+#ifdef MRCHEM_HAS_MPI
+            MPI_File_write_at(fh, static_cast<MPI_Offset>(offset), data, static_cast<int>(count), MPI_CHAR, MPI_STATUS_IGNORE);
+#endif
+        } else {
+            fout.seekp(offset);
+            fout.write(data, count);
+        }
+    };
+
+    if (rank == 0) write_at(0, header.data(), header.size());
+    for (int i_start = p_start; i_start < p_end; i_start += block_size) {
+        int i_end = std::min(i_start + block_size, p_end);
+        long long offset = header.size() + i_start * plane_bytes;
+
+        DoubleVector values;
+        evaluateBlock(tree, nodes, npts, i_start, i_end, values);
+        if (this->binary and dim == 3) {
+            write_at(offset, reinterpret_cast<const char *>(values.data()), values.size() * sizeof(double));
+        } else {
+            auto block = formatBlock(dim, npts, i_start, i_end, values);
+            write_at(offset, block.data(), block.size());
+        }
+    }
+
+#ifdef MRCHEM_HAS_MPI
+    if (parallel) MPI_File_close(&fh);
+#endif
+    if (not parallel) fout.close();
+}
+
+mrcpp::Coord<3> GridPlotter::calcStep(int d, const std::array<int, 3> &npts) const {
+    mrcpp::Coord<3> step{0.0, 0.0, 0.0};
+    if (npts[d] > 1) {
+        for (int x = 0; x < 3; x++) step[x] = this->vecs[d][x] / (npts[d] - 1.0);
+    }
+    return step;
+}
+
+mrcpp::Coord<3> GridPlotter::calcPoint(int i, int j, int k, const std::array<mrcpp::Coord<3>, 3> &steps) const {
+    mrcpp::Coord<3> r;
+    for (int x = 0; x < 3; x++) r[x] = this->O[x] + i * steps[0][x] + j * steps[1][x] + k * steps[2][x];
+    return r;
+}
+
+/** @brief Find the range of grid indices covered by each end node
+ *
+ * The node boxes are mapped into index space through the (pseudo) inverse of
+ * the grid step matrix, and the bounding box of the eight mapped corners gives
+ * a (slightly conservative) index range for each node. The exact membership
+ * of the points is tested during evaluation.
+ */
+std::vector<GridPlotter::PlotNode> GridPlotter::setupNodes(mrcpp::FunctionTree<3> &tree, const std::array<int, 3> &npts) const {
+    Eigen::Matrix3d M = Eigen::Matrix3d::Zero();
+    for (int d = 0; d < 3; d++) {
+        auto step = calcStep(d, npts);
+        for (int x = 0; x < 3; x++) M(x, d) = step[x];
+    }
+    Eigen::Matrix3d M_inv = M.completeOrthogonalDecomposition().pseudoInverse();
+
+    std::vector<PlotNode> nodes;
+    for (int n = 0; n < tree.getNEndNodes(); n++) {
+        auto &node = tree.getEndFuncNode(n);
+        const auto &idx = node.getNodeIndex();
+        double h = std::pow(2.0, -node.getScale());
+
+        PlotNode p_node{&node, {0, 0, 0}, {0, 0, 0}};
+        Eigen::Vector3d t_min = Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+        Eigen::Vector3d t_max = Eigen::Vector3d::Constant(std::numeric_limits<double>::lowest());
+        for (int c = 0; c < 8; c++) {
+            Eigen::Vector3d r;
+            for (int x = 0; x < 3; x++) r(x) = (idx.getTranslation(x) + ((c >> x) & 1)) * h - this->O[x];
+            Eigen::Vector3d t = M_inv * r;
+            t_min = t_min.cwiseMin(t);
+            t_max = t_max.cwiseMax(t);
+        }
+        bool empty = false;
+        for (int d = 0; d < 3; d++) {
+            if (npts[d] > 1) {
+                p_node.lo[d] = std::max(0, static_cast<int>(std::floor(t_min(d))));
+                p_node.hi[d] = std::min(npts[d] - 1, static_cast<int>(std::ceil(t_max(d))));
+            }
+            if (p_node.lo[d] > p_node.hi[d]) empty = true;
+        }
+        if (not empty) nodes.push_back(p_node);
+    }
+    return nodes;
+}
+
+/** @brief Evaluate the function on grid planes [i_start, i_end)
+ *
+ * Each grid point is claimed by the single end node whose half-open box
+ * [l, l+1) contains it (at the node scale), points on the upper boundary of
+ * the world box are included in the outermost nodes. Points outside the
+ * world box are zero. Since every point is owned by exactly one node, the
+ * nodes can be evaluated independently by the threads.
+ */
+void GridPlotter::evaluateBlock(mrcpp::FunctionTree<3> &tree,
+                                const std::vector<PlotNode> &nodes,
+                                const std::array<int, 3> &npts,
+                                int i_start,
+                                int i_end,
+                                DoubleVector &values) const {
+    std::array<mrcpp::Coord<3>, 3> steps{calcStep(0, npts), calcStep(1, npts), calcStep(2, npts)};
+    values = DoubleVector::Zero(static_cast<long long>(i_end - i_start) * npts[1] * npts[2]);
+
+    const auto &basis = tree.getMRA().getScalingBasis();
+    const auto &world = tree.getMRA().getWorldBox();
+    mrcpp::Coord<3> world_ub;
+    for (int x = 0; x < 3; x++) world_ub[x] = world.getUpperBound(x);
+    int kp1 = tree.getKp1();
+
+    int n_nodes = nodes.size();
+#pragma omp parallel for schedule(dynamic)
+    for (int n = 0; n < n_nodes; n++) {
+        const auto &p_node = nodes[n];
+        int lo_0 = std::max(p_node.lo[0], i_start);
+        int hi_0 = std::min(p_node.hi[0], i_end - 1);
+        if (lo_0 > hi_0) continue;
+
+        auto &node = *p_node.node;
+        const auto &idx = node.getNodeIndex();
+        const double *coefs = node.getCoefs();
+        double two_n = std::pow(2.0, node.getScale());
+        double norm = std::pow(2.0, 1.5 * node.getScale());
+
+        std::array<double, 3> l;
+        std::array<bool, 3> at_edge;
+        for (int x = 0; x < 3; x++) {
+            l[x] = idx.getTranslation(x);
+            at_edge[x] = ((l[x] + 1.0) / two_n >= world_ub[x]);
+        }
+
+        Eigen::MatrixXd vals(kp1, 3);
+        for (int i = lo_0; i <= hi_0; i++) {
+            for (int j = p_node.lo[1]; j <= p_node.hi[1]; j++) {
+                for (int k = p_node.lo[2]; k <= p_node.hi[2]; k++) {
+                    auto r = calcPoint(i, j, k, steps);
+
+                    // Scaling by 2^n is exact, so neighbouring nodes agree on the boundaries
+                    bool inside = true;
+                    for (int x = 0; x < 3; x++) {
+                        double y = r[x] * two_n;
+                        if (y < l[x] or y > l[x] + 1.0 or (y == l[x] + 1.0 and not at_edge[x])) inside = false;
+                    }
+                    if (not inside) continue;
+
+                    for (int x = 0; x < 3; x++) {
+                        double arg = r[x] * two_n - l[x];
+                        for (int q = 0; q < kp1; q++) vals(q, x) = basis.getFunc(q).evalf(arg);
+                    }
+
+                    double result = 0.0;
+                    for (int q_z = 0; q_z < kp1; q_z++) {
+                        double s_y = 0.0;
+                        for (int q_y = 0; q_y < kp1; q_y++) {
+                            const double *c = coefs + (q_z * kp1 + q_y) * kp1;
+                            double s_x = 0.0;
+                            for (int q_x = 0; q_x < kp1; q_x++) s_x += c[q_x] * vals(q_x, 0);
+                            s_y += s_x * vals(q_y, 1);
+                        }
+                        result += s_y * vals(q_z, 2);
+                    }
+                    long long pos = (static_cast<long long>(i - i_start) * npts[1] + j) * npts[2] + k;
+                    values(pos) = norm * result;
+                }
+            }
+        }
+    }
+}
+
+/** @brief Standard cube file header, including the molecular geometry */
+std::string GridPlotter::cubeHeader(const std::array<int, 3> &npts) const {
+    std::ostringstream o;
+    auto nNucs = this->molecule->getNNuclei();
+
+    o << "Cube file format" << std::endl;
+    o << "Generated by MRChem" << std::endl;
+
+    o.setf(std::ios::scientific);
+    o.precision(6);
+
+    // Origin
+    o << std::setw(5) << nNucs;
+    o << std::setw(15) << this->O[0];
+    o << std::setw(15) << this->O[1];
+    o << std::setw(15) << this->O[2] << std::endl;
+
+    // Vectors A, B and C
+    for (int d = 0; d < 3; d++) {
+        auto step = calcStep(d, npts);
+        o << std::setw(5) << npts[d];
+        o << std::setw(15) << step[0];
+        o << std::setw(15) << step[1];
+        o << std::setw(15) << step[2] << std::endl;
+    }
+
+    // Atomic coordinates
+    for (auto i = 0; i < nNucs; i++) {
+        const auto &nuc = this->molecule->getNuclei()[i];
+        const auto &coord = nuc.getCoord();
+        auto Z = nuc.getCharge();
+        o << std::setw(5) << static_cast<int>(Z);
+        o << std::setw(15) << Z;
+        o << std::setw(15) << coord[0];
+        o << std::setw(15) << coord[1];
+        o << std::setw(15) << coord[2] << std::endl;
+    }
+    return o.str();
+}
+
+/** @brief Size in bytes of one plane of the grid in the output file */
+long long GridPlotter::planeBytes(int dim, const std::array<int, 3> &npts) const {
+    long long n_yz = static_cast<long long>(npts[1]) * npts[2];
+    if (dim < 3) return n_yz * (4 * line_width + 1);
+    if (this->binary) return n_yz * sizeof(double);
+    long long row_bytes = static_cast<long long>(cube_width) * npts[2] + (npts[2] + 5) / 6;
+    return npts[1] * row_bytes;
+}
+
+/** @brief Text representation of grid planes [i_start, i_end)
+ *
+ * Line and surface plots are written as one "x y z value" line per point.
+ * Cube values are written six per line, with a line break after each row
+ * along the C direction, as in the standard cube format.
+ */
+std::string GridPlotter::formatBlock(int dim, const std::array<int, 3> &npts, int i_start, int i_end, const DoubleVector &values) const {
+    std::array<mrcpp::Coord<3>, 3> steps{calcStep(0, npts), calcStep(1, npts), calcStep(2, npts)};
+    auto clamp = [](double v) {
+        // Keep two exponent digits to retain the fixed field width
+        if (std::abs(v) < 1.0e-99) return 0.0;
+        return std::max(-9.9e99, std::min(9.9e99, v));
+    };
+
+    std::string out;
+    out.reserve((i_end - i_start) * planeBytes(dim, npts));
+    char buf[4 * line_width + 2];
+    long long pos = 0;
+    for (int i = i_start; i < i_end; i++) {
+        for (int j = 0; j < npts[1]; j++) {
+            for (int k = 0; k < npts[2]; k++, pos++) {
+                if (dim < 3) {
+                    auto r = calcPoint(i, j, k, steps);
+                    std::snprintf(buf, sizeof(buf), "%15.6E%15.6E%15.6E%15.6E\n", clamp(r[0]), clamp(r[1]), clamp(r[2]), clamp(values(pos)));
+                } else {
+                    std::snprintf(buf, sizeof(buf), "%13.5E", clamp(values(pos)));
+                    if (k % 6 == 5 or k == npts[2] - 1) std::strcat(buf, "\n");
+                }
+                out += buf;
+            }
+        }
+    }
+    return out;
+}
+
+} // namespace mrchem
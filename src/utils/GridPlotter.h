@@ -0,0 +1,97 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+#pragma once
+
+#include <MRCPP/MWFunctions>
+
+#include "mrchem.h"
+#include "qmfunctions/qmfunction_fwd.h"
+
+namespace mrchem {
+
+class Molecule;
+
+/** @class GridPlotter
+ *
+ * @brief Parallel plotting of functions on regular line, surface and cube grids
+ *
+ * The grid is spanned by the vectors A, B and C starting from the origin O,
+ * with point (i,j,k) located at O + i*a + j*b + k*c, where a = A/(n_A - 1)
+ * etc. Instead of locating each grid point in the tree, the function is
+ * evaluated node by node: each end node collects the grid points within its
+ * support and evaluates its scaling expansion on them. The nodes are shared
+ * among the OpenMP threads, and the grid is processed in blocks of planes
+ * which are written to file as soon as they are computed.
+ *
+ * Functions that are available on all MPI ranks (densities) can be plotted
+ * collectively, in which case the grid planes are split among the ranks of
+ * comm_orb and each rank writes its own part of the file. All text output is
+ * written in fixed width fields, so the file offset of each grid plane is
+ * known in advance.
+ */
+class GridPlotter final {
+public:
+    GridPlotter(const Molecule &mol, const mrcpp::Coord<3> &o);
+
+    void setRange(const mrcpp::Coord<3> &a, const mrcpp::Coord<3> &b, const mrcpp::Coord<3> &c);
+    void setFormat(const std::string &fmt);
+
+    void linePlot(const std::array<int, 1> &npts, QMFunction &func, const std::string &fname, bool collective = false);
+    void surfPlot(const std::array<int, 2> &npts, QMFunction &func, const std::string &fname, bool collective = false);
+    void cubePlot(const std::array<int, 3> &npts, QMFunction &func, const std::string &fname, bool collective = false);
+
+private:
+    /** Grid points (inclusive index range) covered by one end node */
+    struct PlotNode {
+        mrcpp::FunctionNode<3> *node;
+        std::array<int, 3> lo;
+        std::array<int, 3> hi;
+    };
+
+    bool binary{false};
+    const Molecule *molecule{nullptr};
+    mrcpp::Coord<3> O{0.0, 0.0, 0.0};
+    std::array<mrcpp::Coord<3>, 3> vecs{};
+
+    void plot(int dim, const std::array<int, 3> &npts, mrcpp::FunctionTree<3> &tree, const std::string &fname, bool collective);
+
+    mrcpp::Coord<3> calcStep(int d, const std::array<int, 3> &npts) const;
+    mrcpp::Coord<3> calcPoint(int i, int j, int k, const std::array<mrcpp::Coord<3>, 3> &steps) const;
+
+    std::vector<PlotNode> setupNodes(mrcpp::FunctionTree<3> &tree, const std::array<int, 3> &npts) const;
+    void evaluateBlock(mrcpp::FunctionTree<3> &tree,
+                       const std::vector<PlotNode> &nodes,
+                       const std::array<int, 3> &npts,
+                       int i_start,
+                       int i_end,
+                       DoubleVector &values) const;
+
+    std::string cubeHeader(const std::array<int, 3> &npts) const;
+    std::string formatBlock(int dim, const std::array<int, 3> &npts, int i_start, int i_end, const DoubleVector &values) const;
+    long long planeBytes(int dim, const std::array<int, 3> &npts) const;
+};
+
+} // namespace mrchem
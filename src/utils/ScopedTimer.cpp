@@ -0,0 +1,245 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include <MRCPP/Printer>
+#include <MRCPP/Timer>
+
+#include "ScopedTimer.h"
+#include "memory_utils.h"
+
+#ifdef MRCHEM_HAS_OMP
+#ifndef MRCPP_HAS_OMP
+#include <omp.h>
+#endif
+#define mrchem_in_parallel() omp_in_parallel()
+#else
+#define mrchem_in_parallel() 0
+#endif
+
+using json = nlohmann::json;
+
+namespace mrchem {
+
+namespace {
+struct TimerNode {
+    std::string name;
+    int calls{0};
+    double total{0.0};
+    double peak{0.0};
+    mrcpp::Timer timer{false};
+    TimerNode *parent{nullptr};
+    std::vector<std::unique_ptr<TimerNode>> children;
+
+    TimerNode *getChild(const std::string &n) {
+        for (auto &child : this->children) {
+            if (child->name == n) return child.get();
+        }
+        this->children.push_back(std::make_unique<TimerNode>());
+        auto *child = this->children.back().get();
+        child->name = n;
+        child->parent = this;
+        return child;
+    }
+};
+
+TimerNode root_node;
+TimerNode *current_node = &root_node;
+
+void flatten(const TimerNode &node,
+             const std::string &path,
+             std::vector<std::string> &paths,
+             std::vector<double> &times,
+             std::vector<double> &peaks,
+             std::vector<int> &calls) {
+    for (const auto &child : node.children) {
+        auto child_path = (path.empty()) ? child->name : path + "/" + child->name;
+        paths.push_back(child_path);
+        times.push_back(child->total);
+        peaks.push_back(child->peak);
+        calls.push_back(child->calls);
+        flatten(*child, child_path, paths, times, peaks, calls);
+    }
+}
+} // namespace
+
+/** @brief Open a timing section as child of the currently open section */
+void timings::enter(const std::string &name) {
+    if (mrchem_in_parallel()) return;
+    double usage = memory_utils::get_usage();
+    current_node->peak = std::max(current_node->peak, usage);
+    current_node = current_node->getChild(name);
+    current_node->peak = std::max(current_node->peak, usage);
+    current_node->timer.start();
+}
+
+/** @brief Close the currently open timing section */
+void timings::leave(const std::string &name) {
+    if (mrchem_in_parallel()) return;
+    if (current_node == &root_node or current_node->name != name) MSG_ERROR("Unbalanced timing section: " << name);
+    current_node->timer.stop();
+    current_node->total += current_node->timer.elapsed();
+    current_node->calls++;
+    current_node->peak = std::max(current_node->peak, memory_utils::get_usage());
+    current_node->parent->peak = std::max(current_node->parent->peak, current_node->peak);
+    current_node = current_node->parent;
+}
+
+/** @brief Remove all timing sections that are not currently open */
+void timings::clear() {
+    if (current_node != &root_node) MSG_ERROR("Cannot clear timings with open sections");
+    root_node.children.clear();
+}
+
+/** @brief Accumulated wall time of all sections below the currently open section
+ *
+ * Returns a flat JSON object with the local wall time (sec) of each section,
+ * keyed by its path relative to the currently open section, e.g.
+ * "fock_setup/exchange".
+ */
+json timings::snapshot() {
+    std::vector<std::string> paths;
+    std::vector<double> times;
+    std::vector<double> peaks;
+    std::vector<int> calls;
+    flatten(*current_node, "", paths, times, peaks, calls);
+
+    json out = json::object();
+    for (int i = 0; i < paths.size(); i++) out[paths[i]] = times[i];
+    return out;
+}
+
+/** @brief Wall time spent in each section since a snapshot was taken
+ *
+ * Must be called with the same section open as when the snapshot was taken.
+ * Returns a nested JSON (sub-sections under the "sections" key) with the
+ * local wall time (sec) of every section that has been entered in between.
+ */
+json timings::since(const json &snap) {
+    json out = json::object();
+    auto now = timings::snapshot();
+    for (auto &item : now.items()) {
+        double t_0 = snap.value(item.key(), 0.0);
+        double t_1 = item.value().get<double>();
+        if (t_1 - t_0 <= 0.0) continue;
+
+        json *section = &out;
+        std::istringstream iss(item.key());
+        std::string name;
+        std::getline(iss, name, '/');
+        for (std::string next; std::getline(iss, next, '/'); name = next) section = &(*section)[name]["sections"];
+        (*section)[name]["wall_time"] = t_1 - t_0;
+    }
+    return out;
+}
+
+/** @brief Collect the timing sections from all ranks in a nested JSON
+ *
+ * Each section reports the max number of calls and the min/avg/max of the
+ * accumulated wall time and of the peak memory (MB) across the ranks of the
+ * communicator, where ranks that never entered a section count with zero.
+ * Sub-sections are given under the "sections" key. This is a collective
+ * operation.
+ */
+json timings::report(MPI_Comm comm) {
+    std::vector<std::string> loc_paths;
+    std::vector<double> loc_times;
+    std::vector<double> loc_peaks;
+    std::vector<int> loc_calls;
+    flatten(root_node, "", loc_paths, loc_times, loc_peaks, loc_calls);
+
+    // Union of all section paths in order of first appearance (rank by rank),
+    // this keeps every parent section ahead of its children
+    std::vector<std::string> paths = loc_paths;
+    int comm_size = 1;
+#ifdef MRCHEM_HAS_MPI
+    MPI_Comm_size(comm, &comm_size);
+    if (comm_size > 1) {
+        std::string loc_str;
+        for (const auto &path : loc_paths) loc_str += path + "\n";
+        int loc_len = loc_str.size();
+        std::vector<int> lens(comm_size), displs(comm_size, 0);
+        MPI_Allgather(&loc_len, 1, MPI_INT, lens.data(), 1, MPI_INT, comm);
+        for (int i = 1; i < comm_size; i++) displs[i] = displs[i - 1] + lens[i - 1];
+        std::string all_str(displs.back() + lens.back(), ' ');
+        MPI_Allgatherv(loc_str.data(), loc_len, MPI_CHAR, &all_str[0], lens.data(), displs.data(), MPI_CHAR, comm);
+
+        paths.clear();
+        std::set<std::string> seen;
+        std::istringstream iss(all_str);
+        for (std::string path; std::getline(iss, path);) {
+            if (seen.insert(path).second) paths.push_back(path);
+        }
+    }
+#endif
+
+    int n_paths = paths.size();
+    DoubleVector t_min = DoubleVector::Zero(n_paths);
+    DoubleVector m_min = DoubleVector::Zero(n_paths);
+    IntVector n_calls = IntVector::Zero(n_paths);
+    for (int i = 0; i < n_paths; i++) {
+        for (int j = 0; j < loc_paths.size(); j++) {
+            if (loc_paths[j] != paths[i]) continue;
+            t_min(i) = loc_times[j];
+            m_min(i) = loc_peaks[j];
+            n_calls(i) = loc_calls[j];
+        }
+    }
+    DoubleVector t_max = t_min;
+    DoubleVector t_sum = t_min;
+    DoubleVector m_max = m_min;
+    DoubleVector m_sum = m_min;
+#ifdef MRCHEM_HAS_MPI
+    if (comm_size > 1 and n_paths > 0) {
+        MPI_Allreduce(MPI_IN_PLACE, t_min.data(), n_paths, MPI_DOUBLE, MPI_MIN, comm);
+        MPI_Allreduce(MPI_IN_PLACE, t_max.data(), n_paths, MPI_DOUBLE, MPI_MAX, comm);
+        MPI_Allreduce(MPI_IN_PLACE, t_sum.data(), n_paths, MPI_DOUBLE, MPI_SUM, comm);
+        MPI_Allreduce(MPI_IN_PLACE, m_min.data(), n_paths, MPI_DOUBLE, MPI_MIN, comm);
+        MPI_Allreduce(MPI_IN_PLACE, m_max.data(), n_paths, MPI_DOUBLE, MPI_MAX, comm);
+        MPI_Allreduce(MPI_IN_PLACE, m_sum.data(), n_paths, MPI_DOUBLE, MPI_SUM, comm);
+        MPI_Allreduce(MPI_IN_PLACE, n_calls.data(), n_paths, MPI_INT, MPI_MAX, comm);
+    }
+#endif
+
+    json out = json::object();
+    for (int i = 0; i < n_paths; i++) {
+        json *section = &out;
+        std::istringstream iss(paths[i]);
+        std::string name;
+        std::getline(iss, name, '/');
+        for (std::string next; std::getline(iss, next, '/'); name = next) section = &(*section)[name]["sections"];
+        (*section)[name]["calls"] = n_calls(i);
+        (*section)[name]["wall_time"] = {{"min", t_min(i)}, {"avg", t_sum(i) / comm_size}, {"max", t_max(i)}};
+        (*section)[name]["peak_memory"] = {{"min", m_min(i)}, {"avg", m_sum(i) / comm_size}, {"max", m_max(i)}};
+    }
+    return out;
+}
+
+} // namespace mrchem
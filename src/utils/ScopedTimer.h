@@ -0,0 +1,81 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+#pragma once
+
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "parallel.h"
+
+/** @file ScopedTimer.h
+ *
+ * @brief Hierarchical registry of named timing sections
+ *
+ * Timing sections are opened and closed through the lifetime of ScopedTimer
+ * objects, and nested sections are stored as children of the currently open
+ * section, e.g. "scf" -> "fock_setup" -> "exchange". Each section accumulates
+ * the number of calls and the total wall time spent in it on the local rank,
+ * as well as the peak resident memory sampled when entering and leaving the
+ * section or any of its sub-sections.
+ * The statistics across ranks are collected by timings::report.
+ *
+ * Per-iteration timings are obtained by taking a timings::snapshot of the
+ * sections below the currently open one at the start of an iteration, and
+ * timings::since at the end, which gives the wall time spent in each of these
+ * sections in between (local rank only).
+ *
+ * Sections are only recorded on the master thread, outside of OpenMP parallel
+ * regions.
+ */
+
+namespace mrchem {
+
+namespace timings {
+void enter(const std::string &name);
+void leave(const std::string &name);
+void clear();
+nlohmann::json snapshot();
+nlohmann::json since(const nlohmann::json &snap);
+nlohmann::json report(MPI_Comm comm);
+} // namespace timings
+
+class ScopedTimer final {
+public:
+    explicit ScopedTimer(const std::string &n)
+            : name(n) {
+        timings::enter(this->name);
+    }
+    ~ScopedTimer() { timings::leave(this->name); }
+
+    ScopedTimer(const ScopedTimer &timer) = delete;
+    ScopedTimer &operator=(const ScopedTimer &timer) = delete;
+
+private:
+    const std::string name;
+};
+
+} // namespace mrchem
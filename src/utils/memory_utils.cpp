@@ -0,0 +1,172 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <vector>
+
+#include <MRCPP/Printer>
+#include <MRCPP/utils/details.h>
+
+#include "memory_utils.h"
+
+using json = nlohmann::json;
+
+namespace mrchem {
+
+namespace {
+double memory_budget = -1.0;
+double process_peak = 0.0;
+
+// High-water marks of the explicitly recorded categories on this rank
+std::map<std::string, double> category_peak{{"orbitals", 0.0}, {"temporaries", 0.0}, {"bank", 0.0}};
+} // namespace
+
+/** @brief Set the memory budget (MB) per MPI process, non-positive means unlimited */
+void memory_utils::set_budget(double mb) {
+    memory_budget = mb;
+}
+
+/** @brief Return the memory budget (MB) per MPI process */
+double memory_utils::get_budget() {
+    return memory_budget;
+}
+
+/** @brief Test if a memory budget has been set */
+bool memory_utils::has_budget() {
+    return (memory_budget > 0.0);
+}
+
+/** @brief Return the current resident memory (MB) of this process
+ *
+ * Every call updates the high-water mark of the process.
+ */
+double memory_utils::get_usage() {
+    double usage = static_cast<double>(mrcpp::details::get_memory_usage()) / 1024.0;
+    process_peak = std::max(process_peak, usage);
+    return usage;
+}
+
+/** @brief Return the largest resident memory (MB) sampled so far on this process */
+double memory_utils::get_peak() {
+    return process_peak;
+}
+
+/** @brief Record the current memory (MB) held by a given category on this rank
+ *
+ * @param category: "orbitals" or "bank"
+ * @param mb: memory currently held by the category
+ *
+ * Recording the orbitals also samples the process memory, and the
+ * difference is recorded as temporaries.
+ */
+void memory_utils::record(const std::string &category, double mb) {
+    if (category != "orbitals" and category != "bank") MSG_ERROR("Invalid memory category: " << category);
+    category_peak[category] = std::max(category_peak[category], mb);
+    if (category == "orbitals") {
+        double tmp = std::max(get_usage() - mb, 0.0);
+        category_peak["temporaries"] = std::max(category_peak["temporaries"], tmp);
+    }
+}
+
+/** @brief Test if an additional allocation fits within the memory budget
+ *
+ * @param mb: estimated additional memory on this rank
+ * @param comm: ranks that must agree on the decision
+ *
+ * Returns true only if the allocation fits on all ranks of the communicator,
+ * and always true if no budget is set. This is a collective operation when a
+ * budget is set.
+ */
+bool memory_utils::fits(double mb, MPI_Comm comm) {
+    if (not has_budget()) return true;
+    int fits = (get_usage() + mb <= memory_budget) ? 1 : 0;
+#ifdef MRCHEM_HAS_MPI
+    MPI_Allreduce(MPI_IN_PLACE, &fits, 1, MPI_INT, MPI_MIN, comm);
+#endif
+    return (fits > 0);
+}
+
+/** @brief Number of items that can be processed at once within the memory budget
+ *
+ * @param n_items: total number of items
+ * @param mb_per_item: estimated memory per item on this rank
+ * @param comm: ranks that must agree on the decision
+ *
+ * Returns a number in [1, n_items], which is the same on all ranks of the
+ * communicator, and n_items if no budget is set. This is a collective
+ * operation when a budget is set.
+ */
+int memory_utils::get_chunk_size(int n_items, double mb_per_item, MPI_Comm comm) {
+    if (not has_budget() or n_items < 1) return n_items;
+    int n_fit = n_items;
+    if (mb_per_item > 0.0) {
+        double available = std::max(memory_budget - get_usage(), 0.0);
+        n_fit = static_cast<int>(std::min(std::floor(available / mb_per_item), static_cast<double>(n_items)));
+    }
+#ifdef MRCHEM_HAS_MPI
+    MPI_Allreduce(MPI_IN_PLACE, &n_fit, 1, MPI_INT, MPI_MIN, comm);
+#endif
+    return std::max(n_fit, 1);
+}
+
+/** @brief Collect the memory high-water marks from all ranks
+ *
+ * Reports the budget and the min/avg/max across the ranks of the communicator
+ * of the peak process memory and of the recorded categories. This is a
+ * collective operation.
+ */
+json memory_utils::report(MPI_Comm comm) {
+    std::vector<std::string> names{"process"};
+    DoubleVector m_min = DoubleVector::Zero(1 + category_peak.size());
+    m_min(0) = get_peak();
+    int n = 1;
+    for (const auto &category : category_peak) {
+        names.push_back(category.first);
+        m_min(n++) = category.second;
+    }
+    DoubleVector m_max = m_min;
+    DoubleVector m_sum = m_min;
+
+    int comm_size = 1;
+#ifdef MRCHEM_HAS_MPI
+    MPI_Comm_size(comm, &comm_size);
+    if (comm_size > 1) {
+        MPI_Allreduce(MPI_IN_PLACE, m_min.data(), n, MPI_DOUBLE, MPI_MIN, comm);
+        MPI_Allreduce(MPI_IN_PLACE, m_max.data(), n, MPI_DOUBLE, MPI_MAX, comm);
+        MPI_Allreduce(MPI_IN_PLACE, m_sum.data(), n, MPI_DOUBLE, MPI_SUM, comm);
+    }
+#endif
+
+    json out;
+    out["budget"] = (has_budget()) ? json(memory_budget) : json(nullptr);
+    for (int i = 0; i < n; i++) {
+        out[names[i]] = {{"min", m_min(i)}, {"avg", m_sum(i) / comm_size}, {"max", m_max(i)}};
+    }
+    return out;
+}
+
+} // namespace mrchem
@@ -0,0 +1,66 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+#pragma once
+
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "parallel.h"
+
+/** @file memory_utils.h
+ *
+ * @brief Memory accounting and user defined memory budget
+ *
+ * The resident memory of the process is sampled at the boundaries of each
+ * ScopedTimer section, which gives the high-water mark per phase, and the
+ * memory held by specific categories (orbital function trees, bank data) is
+ * recorded explicitly by the solvers. The part of the process memory that is
+ * not accounted for by the function trees is reported as temporaries.
+ *
+ * A positive memory budget (MB per MPI process) lets memory-hungry algorithms
+ * query how much they can allocate, and fall back to lower-memory variants
+ * instead of running out of memory. All memory numbers are in MB.
+ */
+
+namespace mrchem {
+namespace memory_utils {
+
+void set_budget(double mb);
+double get_budget();
+bool has_budget();
+
+double get_usage();
+double get_peak();
+void record(const std::string &category, double mb);
+
+bool fits(double mb, MPI_Comm comm);
+int get_chunk_size(int n_items, double mb_per_item, MPI_Comm comm);
+
+nlohmann::json report(MPI_Comm comm);
+
+} // namespace memory_utils
+} // namespace mrchem
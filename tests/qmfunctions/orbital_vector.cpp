@@ -230,6 +230,30 @@ TEST_CASE("OrbitalVector", "[orbital_vector]") {
         }
     }
 
+    SECTION("centroids") {
+        // gaussian density exp(-2r^2) has variance 1/4 in each direction
+        auto g1 = [](const mrcpp::Coord<3> &r) -> double {
+            double x = r[0] - 1.0;
+            return std::exp(-1.0 * (x * x + r[1] * r[1] + r[2] * r[2]));
+        };
+        OrbitalVector Phi;
+        Phi.push_back(Orbital(SPIN::Paired));
+        Phi.push_back(Orbital(SPIN::Paired));
+        mpi::distribute(Phi);
+
+        if (mpi::my_orb(Phi[0])) qmfunction::project(Phi[0], f1, NUMBER::Real, prec);
+        if (mpi::my_orb(Phi[1])) qmfunction::project(Phi[1], g1, NUMBER::Real, prec);
+
+        DoubleMatrix R = orbital::calc_centroids(Phi);
+        REQUIRE(R(0, 0) == Approx(0.0).margin(0.1));
+        REQUIRE(R(1, 0) == Approx(1.0).margin(0.1));
+        for (int i = 0; i < 2; i++) {
+            REQUIRE(R(i, 1) == Approx(0.0).margin(0.1));
+            REQUIRE(R(i, 2) == Approx(0.0).margin(0.1));
+            REQUIRE(R(i, 3) == Approx(std::sqrt(0.75)).margin(0.1));
+        }
+    }
+
     SECTION("orthogonalization") {
         OrbitalVector Phi;
         Phi.push_back(Orbital(SPIN::Beta));
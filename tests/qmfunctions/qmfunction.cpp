@@ -27,6 +27,7 @@
 
 #include "mrchem.h"
 #include "parallel.h"
+#include "analyticfunctions/HydrogenFunction.h"
 #include "qmfunctions/QMFunction.h"
 #include "qmfunctions/qmfunction_utils.h"
 
@@ -45,6 +46,11 @@ auto g = [](const mrcpp::Coord<3> &r) -> double {
     return std::exp(-2.0 * R * R);
 };
 
+auto h = [](const mrcpp::Coord<3> &r) -> double {
+    double R = std::sqrt((r[0] - 12.0) * (r[0] - 12.0) + r[1] * r[1] + r[2] * r[2]);
+    return std::exp(-1.0 * R * R);
+};
+
 TEST_CASE("QMFunction", "[qmfunction]") {
     const double prec = 1.0e-3;
 
@@ -263,6 +269,30 @@ TEST_CASE("QMFunction", "[qmfunction]") {
         }
     }
 
+    SECTION("product bound") {
+        QMFunction func_1(false);
+        QMFunction func_2(false);
+        QMFunction func_3(false);
+        qmfunction::project(func_1, f, NUMBER::Real, prec);
+        qmfunction::project(func_2, g, NUMBER::Imag, prec);
+        qmfunction::project(func_3, h, NUMBER::Real, prec);
+
+        SECTION("overlapping functions") {
+            QMFunction func_12(false);
+            qmfunction::multiply(func_12, func_1.dagger(), func_2, -1.0);
+            REQUIRE(qmfunction::calc_product_bound(func_1, func_2) >= func_12.norm());
+        }
+        SECTION("distant functions") {
+            REQUIRE(qmfunction::calc_product_bound(func_1, func_3) < prec);
+        }
+        SECTION("cached cell norms") {
+            auto cells_1 = qmfunction::calc_cell_norms(func_1);
+            auto cells_2 = qmfunction::calc_cell_norms(func_2);
+            REQUIRE(cells_1.size() == 1);
+            REQUIRE(qmfunction::calc_product_bound(cells_1, cells_2) == Approx(qmfunction::calc_product_bound(func_1, func_2)));
+        }
+    }
+
     SECTION("multiply shared function") {
         QMFunction func_1(true);
         qmfunction::project(func_1, f, NUMBER::Real, prec);
@@ -281,6 +311,19 @@ TEST_CASE("QMFunction", "[qmfunction]") {
             REQUIRE(func_2.integrate().imag() == Approx(0.0));
         }
     }
+
+    SECTION("batch projection") {
+        HydrogenFunction h(2, 1, 0);
+        auto h_batch = [&h](int n, const double *x, const double *y, const double *z, double *out) {
+            h.evalBatch(n, x, y, z, out);
+        };
+        QMFunction func_1(false);
+        QMFunction func_2(false);
+        qmfunction::project(func_1, h, NUMBER::Real, prec);
+        qmfunction::project(func_2, h, h_batch, NUMBER::Real, prec);
+        REQUIRE(func_2.norm() == Approx(1.0).epsilon(prec));
+        REQUIRE(qmfunction::dot(func_1, func_2).real() == Approx(func_1.squaredNorm()).epsilon(prec));
+    }
 }
 
 } // namespace qmfunction_tests
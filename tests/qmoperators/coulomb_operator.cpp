@@ -132,4 +132,51 @@ TEST_CASE("CoulombOperator", "[coulomb_operator]") {
     V.clear();
 }
 
+TEST_CASE("CoulombOperatorIncremental", "[coulomb_operator]") {
+    const double prec = 1.0e-3;
+    const double thrs = 1.0e-3;
+
+    auto Phi_p = std::make_shared<OrbitalVector>();
+    auto P_p = std::make_shared<mrcpp::PoissonOperator>(*MRA, prec);
+
+    OrbitalVector &Phi = *Phi_p;
+    Phi.push_back(Orbital(SPIN::Paired));
+    Phi.push_back(Orbital(SPIN::Paired));
+    mpi::distribute(Phi);
+
+    for (int i = 0; i < Phi.size(); i++) {
+        HydrogenFunction f(i + 1, 0, 0);
+        if (mpi::my_orb(Phi[i])) qmfunction::project(Phi[i], f, NUMBER::Real, prec);
+    }
+
+    CoulombOperator J(P_p, Phi_p);
+    J.setRebuildInterval(3);
+    J.setup(prec);
+    REQUIRE(J.getNUpdates() == 0);
+    ComplexMatrix j_0 = J(Phi, Phi);
+    J.clear();
+
+    // change the density in each setup by rescaling the second orbital,
+    // two incremental updates are followed by a full rebuild
+    for (int n = 1; n <= 3; n++) {
+        if (mpi::my_orb(Phi[1])) Phi[1].rescale(1.1);
+        J.setup(prec);
+        REQUIRE(J.getNUpdates() == n % 3);
+
+        CoulombOperator J_ref(P_p, Phi_p);
+        J_ref.setup(prec);
+
+        ComplexMatrix j = J(Phi, Phi);
+        ComplexMatrix j_ref = J_ref(Phi, Phi);
+        REQUIRE(std::abs(j_ref(0, 0).real() - j_0(0, 0).real()) > 10.0 * thrs);
+        for (int i = 0; i < Phi.size(); i++) {
+            for (int k = 0; k < Phi.size(); k++) {
+                REQUIRE(j(i, k).real() == Approx(j_ref(i, k).real()).margin(thrs));
+            }
+        }
+        J.clear();
+        J_ref.clear();
+    }
+}
+
 } // namespace coulomb_potential
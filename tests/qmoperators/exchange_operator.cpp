@@ -34,6 +34,8 @@
 #include "qmfunctions/Orbital.h"
 #include "qmfunctions/orbital_utils.h"
 #include "qmfunctions/qmfunction_utils.h"
+#include "qmoperators/OperatorRegistry.h"
+#include "qmoperators/two_electron/ExchangeKernel.h"
 #include "qmoperators/two_electron/ExchangeOperator.h"
 
 using namespace mrchem;
@@ -127,4 +129,295 @@ TEST_CASE("ExchangeOperator", "[exchange_operator]") {
     V.clear();
 }
 
+TEST_CASE("ExchangeOperatorACE", "[exchange_operator]") {
+    const double prec = 1.0e-3;
+    const double thrs = 1.0e-3;
+
+    auto Phi_p = std::make_shared<OrbitalVector>();
+    auto P_p = std::make_shared<mrcpp::PoissonOperator>(*MRA, prec);
+
+    OrbitalVector &Phi = *Phi_p;
+    Phi.push_back(Orbital(SPIN::Paired));
+    Phi.push_back(Orbital(SPIN::Paired));
+    mpi::distribute(Phi);
+
+    for (int i = 0; i < Phi.size(); i++) {
+        HydrogenFunction f(i + 1, 0, 0);
+        if (mpi::my_orb(Phi[i])) qmfunction::project(Phi[i], f, NUMBER::Real, prec);
+    }
+
+    ExchangeOperator K(P_p, Phi_p);
+    K.setPreCompute();
+    K.setACE();
+    K.setup(prec);
+
+    ExchangeOperator K_ref(P_p, Phi_p);
+    K_ref.setup(prec);
+
+    SECTION("trace") {
+        ComplexDouble tr = K.trace(Phi);
+        ComplexDouble tr_ref = K_ref.trace(Phi);
+        REQUIRE(tr.real() == Approx(tr_ref.real()).margin(thrs));
+        REQUIRE(std::abs(tr.imag()) < thrs);
+    }
+    SECTION("perturbed orbitals") {
+        // trial orbitals as after a KAIN step, mostly within the span of the orbitals
+        for (int i = 0; i < Phi.size(); i++) {
+            if (not mpi::my_orb(Phi[i])) continue;
+            HydrogenFunction g(3, 0, 0);
+            Orbital psi_i = Phi[i].paramCopy();
+            qmfunction::project(psi_i, g, NUMBER::Real, prec);
+            psi_i.rescale(0.02);
+            psi_i.add(1.0, Phi[i]);
+
+            Orbital Kpsi_i = K(psi_i);
+            Orbital Kpsi_i_ref = K_ref(psi_i);
+            ComplexDouble K_ii = orbital::dot(psi_i, Kpsi_i);
+            ComplexDouble K_ii_ref = orbital::dot(psi_i, Kpsi_i_ref);
+            REQUIRE(K_ii.real() == Approx(K_ii_ref.real()).margin(thrs));
+            REQUIRE(std::abs(K_ii.imag()) < thrs);
+        }
+    }
+    K_ref.clear();
+    K.clear();
+}
+
+TEST_CASE("ExchangeOperatorIncremental", "[exchange_operator]") {
+    const double prec = 1.0e-3;
+    const double thrs = 1.0e-3;
+
+    auto Phi_p = std::make_shared<OrbitalVector>();
+    auto P_p = std::make_shared<mrcpp::PoissonOperator>(*MRA, prec);
+
+    OrbitalVector &Phi = *Phi_p;
+    Phi.push_back(Orbital(SPIN::Paired));
+    Phi.push_back(Orbital(SPIN::Paired));
+    mpi::distribute(Phi);
+
+    for (int i = 0; i < Phi.size(); i++) {
+        HydrogenFunction f(i + 1, 0, 0);
+        if (mpi::my_orb(Phi[i])) qmfunction::project(Phi[i], f, NUMBER::Real, prec);
+    }
+
+    // full build, with the pair potentials kept as reference
+    ExchangeOperator K(P_p, Phi_p);
+    K.setPreCompute();
+    K.setRebuildInterval(3);
+    K.setup(prec);
+    K.clear();
+
+    // perturb the orbitals, the next setup is an incremental update
+    for (int i = 0; i < Phi.size(); i++) {
+        if (not mpi::my_orb(Phi[i])) continue;
+        HydrogenFunction g(2, 1, i);
+        Orbital dphi = Phi[i].paramCopy();
+        qmfunction::project(dphi, g, NUMBER::Real, prec);
+        Phi[i].add(0.1, dphi);
+    }
+    orbital::normalize(Phi);
+    K.setup(prec);
+    OrbitalVector KPhi = K(Phi);
+
+    // on-the-fly exchange of the perturbed orbitals
+    ExchangeOperator K_ref(P_p, Phi_p);
+    K_ref.setup(prec);
+    OrbitalVector KPhi_ref = K_ref(Phi);
+    for (int i = 0; i < Phi.size(); i++) {
+        if (not mpi::my_orb(Phi[i])) continue;
+        ComplexDouble K_ii = orbital::dot(Phi[i], KPhi[i]);
+        ComplexDouble K_ii_ref = orbital::dot(Phi[i], KPhi_ref[i]);
+        REQUIRE(K_ii.real() == Approx(K_ii_ref.real()).margin(thrs));
+        REQUIRE(std::abs(K_ii.imag()) < thrs);
+    }
+    K_ref.clear();
+    K.clear();
+}
+
+TEST_CASE("ExchangeOperatorPairMatrix", "[exchange_operator]") {
+    const double prec = 1.0e-3;
+    const double thrs = 1.0e-3;
+
+    auto Phi_p = std::make_shared<OrbitalVector>();
+    auto P_p = std::make_shared<mrcpp::PoissonOperator>(*MRA, prec);
+
+    OrbitalVector &Phi = *Phi_p;
+    Phi.push_back(Orbital(SPIN::Alpha));
+    Phi.push_back(Orbital(SPIN::Alpha));
+    Phi.push_back(Orbital(SPIN::Beta));
+    mpi::distribute(Phi);
+
+    for (int i = 0; i < Phi.size(); i++) {
+        HydrogenFunction f(i + 1, 0, 0);
+        if (mpi::my_orb(Phi[i])) qmfunction::project(Phi[i], f, NUMBER::Real, prec);
+    }
+
+    // on-the-fly exchange, the matrix is taken from the pair potentials
+    ExchangeOperator K(P_p, Phi_p);
+    K.setup(prec);
+    REQUIRE(K.useInternalMatrix(Phi));
+
+    OrbitalVector Psi = orbital::deep_copy(Phi);
+    REQUIRE_FALSE(K.useInternalMatrix(Psi));
+
+    ComplexMatrix k_ref = K(Psi, Psi);
+    auto screening = K.getPairScreening();
+    ComplexMatrix k_pair = K.getInternalMatrix();
+    REQUIRE(K.getPairScreening() == screening);
+    for (int i = 0; i < Phi.size(); i++) {
+        for (int j = 0; j < Phi.size(); j++) {
+            REQUIRE(k_pair(i, j).real() == Approx(k_ref(i, j).real()).margin(thrs));
+            REQUIRE(std::abs(k_pair(i, j).imag()) < thrs);
+        }
+    }
+    // no exchange between orbitals of orthogonal spin
+    REQUIRE(std::abs(k_pair(2, 0)) < mrcpp::MachineZero);
+    REQUIRE(std::abs(k_pair(0, 2)) < mrcpp::MachineZero);
+    REQUIRE(std::abs(k_pair(2, 1)) < mrcpp::MachineZero);
+
+    ComplexDouble E_ref = 0.5 * K.RankZeroOperator::trace(Psi);
+    ComplexDouble E_pair = K.trace(Phi);
+    REQUIRE(E_pair.real() == Approx(E_ref.real()).margin(thrs));
+    K.clear();
+}
+
+TEST_CASE("ExchangeOperatorD2", "[exchange_operator]") {
+    const double prec = 1.0e-3;
+    const double thrs = 1.0e-3;
+
+    auto Phi_p = std::make_shared<OrbitalVector>();
+    auto X_p = std::make_shared<OrbitalVector>();
+    auto Y_p = std::make_shared<OrbitalVector>();
+    auto P_p = std::make_shared<mrcpp::PoissonOperator>(*MRA, prec);
+
+    OrbitalVector &Phi = *Phi_p;
+    OrbitalVector &X = *X_p;
+    OrbitalVector &Y = *Y_p;
+    for (int i = 0; i < 2; i++) {
+        Phi.push_back(Orbital(SPIN::Paired));
+        X.push_back(Orbital(SPIN::Paired));
+        Y.push_back(Orbital(SPIN::Paired));
+    }
+    mpi::distribute(Phi);
+    mpi::distribute(X);
+    mpi::distribute(Y);
+
+    for (int i = 0; i < Phi.size(); i++) {
+        HydrogenFunction f(i + 1, 0, 0);
+        HydrogenFunction g(2, 1, i);
+        HydrogenFunction h(2, 1, 1 - i);
+        if (mpi::my_orb(Phi[i])) qmfunction::project(Phi[i], f, NUMBER::Real, prec);
+        if (mpi::my_orb(X[i])) qmfunction::project(X[i], g, NUMBER::Real, prec);
+        if (mpi::my_orb(Y[i])) qmfunction::project(Y[i], h, NUMBER::Real, prec);
+    }
+
+    // precomputed contributions should agree with the on-the-fly application
+    ExchangeOperator K(P_p, Phi_p, X_p, Y_p);
+    ExchangeOperator K_otf(P_p, Phi_p, X_p, Y_p);
+    K.setPreCompute();
+    K.setup(prec);
+    K_otf.setup(prec);
+
+    SECTION("vector apply") {
+        OrbitalVector KPhi = K(Phi);
+        OrbitalVector KPhi_otf = K_otf(Phi);
+        for (int i = 0; i < Phi.size(); i++) {
+            if (not mpi::my_orb(Phi[i])) continue;
+            ComplexDouble K_ii = orbital::dot(X[i], KPhi[i]);
+            ComplexDouble K_ii_otf = orbital::dot(X[i], KPhi_otf[i]);
+            REQUIRE(K_ii.real() == Approx(K_ii_otf.real()).margin(thrs));
+            REQUIRE(K_ii.imag() < thrs);
+        }
+    }
+    SECTION("vector dagger") {
+        OrbitalVector KPhi = K.dagger(Phi);
+        OrbitalVector KPhi_otf = K_otf.dagger(Phi);
+        for (int i = 0; i < Phi.size(); i++) {
+            if (not mpi::my_orb(Phi[i])) continue;
+            ComplexDouble K_ii = orbital::dot(Y[i], KPhi[i]);
+            ComplexDouble K_ii_otf = orbital::dot(Y[i], KPhi_otf[i]);
+            REQUIRE(K_ii.real() == Approx(K_ii_otf.real()).margin(thrs));
+            REQUIRE(K_ii.imag() < thrs);
+        }
+    }
+    SECTION("shared pairs") {
+        // the pair potentials are taken from the unperturbed operator, and
+        // computed only by the first of the response operators that share them
+        ExchangeOperator K_0(P_p, Phi_p);
+        ExchangeOperator K_other(std::make_shared<mrcpp::PoissonOperator>(*MRA, prec), Phi_p);
+        for (int n = 0; n < 2; n++) {
+            ExchangeOperator K_n(P_p, Phi_p, X_p, Y_p);
+            REQUIRE_FALSE(K_n.sharePairs(K_other));
+            REQUIRE(K_n.sharePairs(K_0));
+            K_n.setPreCompute();
+            K_n.setup(prec);
+            OrbitalVector KPhi = K_n(Phi);
+            OrbitalVector KPhi_otf = K_otf(Phi);
+            for (int i = 0; i < Phi.size(); i++) {
+                if (not mpi::my_orb(Phi[i])) continue;
+                ComplexDouble K_ii = orbital::dot(X[i], KPhi[i]);
+                ComplexDouble K_ii_otf = orbital::dot(X[i], KPhi_otf[i]);
+                REQUIRE(K_ii.real() == Approx(K_ii_otf.real()).margin(thrs));
+            }
+            K_n.clear();
+        }
+    }
+    K.clear();
+    K_otf.clear();
+}
+
+TEST_CASE("ExchangeOperatorRangeSeparated", "[exchange_operator]") {
+    const double prec = 1.0e-3;
+    const double thrs = 1.0e-3;
+    const double mu = 0.4;
+
+    auto Phi_p = std::make_shared<OrbitalVector>();
+
+    OrbitalVector &Phi = *Phi_p;
+    Phi.push_back(Orbital(SPIN::Paired));
+    Phi.push_back(Orbital(SPIN::Paired));
+    mpi::distribute(Phi);
+
+    for (int i = 0; i < Phi.size(); i++) {
+        HydrogenFunction f(i + 1, 0, 0);
+        if (mpi::my_orb(Phi[i])) qmfunction::project(Phi[i], f, NUMBER::Real, prec);
+    }
+
+    auto P_sr = exchange_kernel::short_range(*MRA, mu, prec);
+    auto P_lr = exchange_kernel::long_range(*MRA, mu, prec);
+    auto P_yk = exchange_kernel::yukawa(*MRA, mu, prec);
+    auto P_p = exchange_kernel::coulomb(*MRA, prec);
+    REQUIRE(P_sr == exchange_kernel::short_range(*MRA, mu, prec));
+    REQUIRE(P_sr != exchange_kernel::short_range(*MRA, 2.0 * mu, prec));
+    REQUIRE(P_p == operator_registry::poisson(*MRA, prec));
+    REQUIRE(P_yk == operator_registry::helmholtz(*MRA, mu, prec));
+
+    ExchangeOperator K(P_p, Phi_p);
+    ExchangeOperator K_sr(P_sr, Phi_p);
+    ExchangeOperator K_lr(P_lr, Phi_p);
+    ExchangeOperator K_yk(P_yk, Phi_p);
+    K.setup(prec);
+    K_sr.setup(prec);
+    K_lr.setup(prec);
+    K_yk.setup(prec);
+
+    // the short- and long-range parts add up to the full exchange,
+    // while the screened exchange is strictly smaller
+    ComplexMatrix k = K(Phi, Phi);
+    ComplexMatrix k_sr = K_sr(Phi, Phi);
+    ComplexMatrix k_lr = K_lr(Phi, Phi);
+    ComplexMatrix k_yk = K_yk(Phi, Phi);
+    for (int i = 0; i < Phi.size(); i++) {
+        if (not mpi::my_orb(Phi[i])) continue;
+        REQUIRE(k_sr(i, i).real() > thrs);
+        REQUIRE(k_lr(i, i).real() > thrs);
+        REQUIRE((k_sr(i, i) + k_lr(i, i)).real() == Approx(k(i, i).real()).margin(thrs));
+        REQUIRE(k_yk(i, i).real() < k(i, i).real());
+    }
+    K.clear();
+    K_sr.clear();
+    K_lr.clear();
+    K_yk.clear();
+    operator_registry::clear();
+}
+
 } // namespace exchange_potential
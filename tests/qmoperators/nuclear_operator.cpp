@@ -31,11 +31,15 @@
 #include "parallel.h"
 
 #include "analyticfunctions/HydrogenFunction.h"
+#include "analyticfunctions/NuclearFunction.h"
 #include "chemistry/Nucleus.h"
+#include "qmfunctions/Density.h"
 #include "qmfunctions/Orbital.h"
 #include "qmfunctions/orbital_utils.h"
 #include "qmfunctions/qmfunction_utils.h"
+#include "qmoperators/NuclearFieldCache.h"
 #include "qmoperators/one_electron/NuclearOperator.h"
+#include "utils/math_utils.h"
 
 using namespace mrchem;
 using namespace orbital;
@@ -134,4 +138,110 @@ TEST_CASE("NuclearOperator", "[nuclear_operator]") {
     V.clear();
 }
 
+TEST_CASE("NuclearFieldCache", "[nuclear_operator]") {
+    const double prec = 1.0e-3;
+
+    Nuclei nucs;
+    nucs.push_back("H", {0.0, 0.0, 0.0});
+    nucs.push_back("H", {0.0, 0.0, 1.4});
+
+    auto V_1 = nuclear_field_cache::potential(nucs, prec, prec, false);
+    auto V_2 = nuclear_field_cache::potential(nucs, prec, prec, false);
+    REQUIRE(V_1 == V_2);
+
+    auto V_3 = nuclear_field_cache::potential(nucs, prec / 10.0, prec, false);
+    REQUIRE(V_1 != V_3);
+
+    Nuclei nucs_2 = nucs;
+    nucs_2.push_back("H", {0.0, 0.0, 2.8});
+    auto V_4 = nuclear_field_cache::potential(nucs_2, prec, prec, false);
+    REQUIRE(V_1 != V_4);
+
+    // Cached densities share their function trees
+    Density rho_1 = nuclear_field_cache::density(prec, nucs, 1000.0);
+    Density rho_2 = nuclear_field_cache::density(prec, nucs, 1000.0);
+    REQUIRE(&rho_1.real() == &rho_2.real());
+    REQUIRE(rho_1.integrate().real() == Approx(2.0).epsilon(prec));
+
+    nuclear_field_cache::clear();
+}
+
+TEST_CASE("NuclearFunction", "[nuclear_operator]") {
+    const double c = 1.0e-2;
+    Nuclei nucs;
+    nucs.push_back("O", {0.0, 0.0, 0.0});
+    nucs.push_back("H", {1.5, 1.1, 0.0});
+    nucs.push_back("H", {-1.5, 1.1, 0.0});
+    nucs.push_back("C", {4.0, -2.0, 1.0});
+    nucs.push_back("N", {-3.0, 0.5, -2.5});
+
+    NuclearFunction f;
+    for (auto &nuc : nucs) f.push_back(nuc, c);
+
+    // brute force sum over all nuclei with the smoothed potential
+    auto ref = [&nucs, c](const mrcpp::Coord<3> &r) {
+        double c_s = -1.0 / (3.0 * mrcpp::root_pi);
+        double result = 0.0;
+        for (auto &nuc : nucs) {
+            double R1 = math_utils::calc_distance(r, nuc.getCoord()) / c;
+            double u = -std::erf(R1) / R1 + c_s * (std::exp(-R1 * R1) + 16.0 * std::exp(-4.0 * R1 * R1));
+            result += nuc.getCharge() * u / c;
+        }
+        return result;
+    };
+
+    SECTION("evaluate") {
+        std::vector<mrcpp::Coord<3>> points = {{0.01, 0.0, 0.0}, {1.5, 1.1, 0.02}, {-1.49, 1.1, 0.0}, {0.7, 0.3, -0.2}, {4.0, -2.0, 1.03}, {-10.0, 5.0, 3.0}};
+        for (auto &r : points) REQUIRE(f.evalf(r) == Approx(ref(r)).epsilon(1.0e-12));
+    }
+    SECTION("batch evaluate") {
+        std::vector<double> x = {0.01, 1.5, -1.49, 0.7, 4.0, -10.0};
+        std::vector<double> y = {0.0, 1.1, 1.1, 0.3, -2.0, 5.0};
+        std::vector<double> z = {0.0, 0.02, 0.0, -0.2, 1.03, 3.0};
+        std::vector<double> f_batch(x.size());
+        f.evalBatch(x.size(), x.data(), y.data(), z.data(), f_batch.data());
+        for (int i = 0; i < x.size(); i++) {
+            mrcpp::Coord<3> r{x[i], y[i], z[i]};
+            REQUIRE(f_batch[i] == Approx(f.evalf(r)).epsilon(1.0e-12));
+        }
+    }
+    SECTION("multipole far field") {
+        NuclearFunction f_exact;
+        NuclearFunction f_multi;
+        for (int i = 0; i < 6; i++) {
+            for (int j = 0; j < 6; j++) {
+                for (int k = 0; k < 6; k++) {
+                    mrcpp::Coord<3> R{3.0 * i, 2.5 * j, 2.0 * k};
+                    f_exact.push_back((i + j + k) % 2 ? "H" : "C", R, c);
+                    f_multi.push_back((i + j + k) % 2 ? "H" : "C", R, c);
+                }
+            }
+        }
+        f_multi.setFarFieldPrecision(1.0e-8);
+        std::vector<mrcpp::Coord<3>> points = {{0.01, 0.0, 0.0}, {7.5, 6.2, 5.1}, {-20.0, 30.0, 10.0}, {14.9, 12.5, 10.0}, {60.0, 0.0, 0.0}};
+        for (auto &r : points) REQUIRE(f_multi.evalf(r) == Approx(f_exact.evalf(r)).epsilon(1.0e-7));
+
+        for (auto &r_0 : points) {
+            std::vector<double> x, y, z;
+            for (int i = 0; i < 64; i++) {
+                x.push_back(r_0[0] + 0.1 * (i % 4));
+                y.push_back(r_0[1] + 0.1 * ((i / 4) % 4));
+                z.push_back(r_0[2] + 0.1 * (i / 16));
+            }
+            std::vector<double> v_exact(64), v_multi(64);
+            f_exact.evalBatch(64, x.data(), y.data(), z.data(), v_exact.data());
+            f_multi.evalBatch(64, x.data(), y.data(), z.data(), v_multi.data());
+            for (int i = 0; i < 64; i++) REQUIRE(v_multi[i] == Approx(v_exact[i]).epsilon(1.0e-7));
+        }
+    }
+    SECTION("zero on interval") {
+        double a_1[3] = {1.0, 1.0, -1.0};
+        double b_1[3] = {2.0, 2.0, 1.0};
+        REQUIRE_FALSE(f.isZeroOnInterval(a_1, b_1));
+        double a_2[3] = {1.0, -1.0, -1.0};
+        double b_2[3] = {2.0, 1.0, 1.0};
+        REQUIRE(f.isZeroOnInterval(a_2, b_2));
+    }
+}
+
 } // namespace nuclear_potential
@@ -0,0 +1,85 @@
+/*
+ * MRChem, a numerical real-space code for molecular electronic structure
+ * calculations within the self-consistent field (SCF) approximations of quantum
+ * chemistry (Hartree-Fock and Density Functional Theory).
+ * Copyright (C) 2021 Stig Rune Jensen, Luca Frediani, Peter Wind and contributors.
+ *
+ * This file is part of MRChem.
+ *
+ * MRChem is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * MRChem is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with MRChem.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * For information on the complete list of contributors to MRChem, see:
+ * <https://mrchem.readthedocs.io/>
+ */
+
+#include "catch.hpp"
+
+#include <cmath>
+
+#include "MRCPP/MWOperators"
+
+#include "mrchem.h"
+
+#include "scf_solver/HelmholtzCache.h"
+
+using namespace mrchem;
+
+namespace helmholtz_cache_tests {
+
+TEST_CASE("HelmholtzCache", "[helmholtz_cache]") {
+    const double prec = 1.0e-3;
+
+    SECTION("quantize") {
+        REQUIRE(helmholtz_cache::quantize_mu(1.0) == Approx(1.0));
+        for (double mu : {0.3, 1.2, 7.5}) {
+            double mu_q = helmholtz_cache::quantize_mu(mu);
+            REQUIRE(std::abs(mu_q - mu) < 0.005 * mu);
+            REQUIRE(helmholtz_cache::quantize_mu(mu_q) == Approx(mu_q));
+        }
+        REQUIRE(helmholtz_cache::quantize_prec(prec) == Approx(prec));
+        double prec_q = helmholtz_cache::quantize_prec(2.0 * prec);
+        REQUIRE(prec_q <= 2.0 * prec);
+        REQUIRE(prec_q > 2.0 * prec * std::pow(10.0, -0.1));
+    }
+
+    SECTION("reuse and eviction") {
+        helmholtz_cache::clear();
+        helmholtz_cache::set_max_entries(2);
+
+        // nearby parameters share the operator
+        auto H_1 = helmholtz_cache::get(*MRA, 1.0, prec);
+        REQUIRE(H_1 == helmholtz_cache::get(*MRA, 1.001, prec));
+        REQUIRE(H_1 == helmholtz_cache::get(*MRA, 1.0, 1.05 * prec));
+        REQUIRE(helmholtz_cache::size() == 1);
+
+        auto H_2 = helmholtz_cache::get(*MRA, 2.0, prec);
+        REQUIRE(H_2 != H_1);
+        REQUIRE(helmholtz_cache::size() == 2);
+
+        // H_1 is used last, so H_2 is evicted for H_3
+        REQUIRE(H_1 == helmholtz_cache::get(*MRA, 1.0, prec));
+        auto H_3 = helmholtz_cache::get(*MRA, 3.0, prec);
+        REQUIRE(helmholtz_cache::size() == 2);
+        REQUIRE(H_1 == helmholtz_cache::get(*MRA, 1.0, prec));
+        REQUIRE(H_3 == helmholtz_cache::get(*MRA, 3.0, prec));
+        REQUIRE(H_2 != helmholtz_cache::get(*MRA, 2.0, prec));
+        REQUIRE(helmholtz_cache::size() == 2);
+
+        helmholtz_cache::set_max_entries(64);
+        helmholtz_cache::clear();
+        REQUIRE(helmholtz_cache::size() == 0);
+    }
+}
+
+} // namespace helmholtz_cache_tests
@@ -78,5 +78,16 @@ TEST_CASE("Cavityfunction", "[cavity_function]") {
 
     double two_sphere_volume = two_cav_tree.integrate();
     REQUIRE(two_sphere_volume == Approx(7.5096630756284952213).epsilon(thrs * 10));
+
+    // test batch evaluation against point evaluation
+    std::vector<double> x = {0.0, 0.3, 0.9, -1.2, 2.0};
+    std::vector<double> y = {0.0, 0.2, -0.1, 0.4, 0.0};
+    std::vector<double> z = {0.5, 1.1, 0.0, 1.3, -0.5};
+    std::vector<double> c_batch(x.size());
+    two_spheres.evalBatch(x.size(), x.data(), y.data(), z.data(), c_batch.data());
+    for (int i = 0; i < x.size(); i++) {
+        mrcpp::Coord<3> r{x[i], y[i], z[i]};
+        REQUIRE(c_batch[i] == Approx(two_spheres.evalf(r)).margin(thrs));
+    }
 }
 } // namespace cavity_function